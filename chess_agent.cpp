@@ -1,18 +1,45 @@
 #include <iostream>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <math.h>
 #include <time.h>
 #include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(USE_PEXT) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 #define MAX_MOVES 256
+#undef INFINITY // The float one from math.h, scores use the integer below
 #define INFINITY 1000000
-#define MAX_DEPTH 5
-
+#define MAX_DEPTH 64
+#define MATE_SCORE 32000 // Mate at the root, mates further away score one less per ply
+#define MAX_PLY 128
+#define ASPIRATION_WINDOW 25 // Initial half width of the root window around the previous score
+#define DELTA_MARGIN 200 // Positional slack allowed on top of a capture in quiescence delta pruning
+#define REVERSE_FUTILITY_MARGIN 80 // Per ply of remaining depth
+#define FUTILITY_MARGIN 120 // Per ply of remaining depth, on top of FUTILITY_BASE
+#define FUTILITY_BASE 100
+#define RAZOR_MARGIN 300 // Per ply of remaining depth
+#define NNUE_HIDDEN 256 // Accumulator width per side, a multiple of 16
+#define BATCH_DEFAULT_NODES 100000 // Batch positions given neither a time nor a node limit
+#define PAWN_HASH_SIZE 65536 // Pawn table entries per search thread, a power of two
+
+// Indexed by peice type (PEICE_TYPE), used for exchanges and move ordering
 const int PEICE_VALUES[7] = {
     0, // Empty
     100, //Pawn
-    200, // Knight
-    300, // Bishop
+    320, // Knight
+    330, // Bishop
     500, // Rook
     900, // Queen
     2000 // King
@@ -24,7 +51,21 @@ enum Peice {
     B_PAWN, B_KNIGHT, B_BISHOP, B_ROOK, B_QUEEN, B_KING,
 };
 
+enum GenType { GEN_ALL, GEN_CAPTURES, GEN_QUIETS };
+
+// First layer output of the network for both perspectives, white [0] and black [1]
+typedef struct {
+    int16_t values[2][NNUE_HIDDEN];
+} Accumulator;
+
+// Defined further down, with the evaluation and with the search
+typedef struct Network Network;
+typedef struct Engine Engine;
+
 // Board State representation
+// Every field up to fullmove_number mirrors the ctypes struct passed from Python, so a
+// Python Board is a valid prefix of this one (PYTHON_BOARD_SIZE bytes). The bitboards after it are derived from
+// squares[] by init_board_state() and kept in sync by apply_move/undo_move.
 typedef struct {
     int squares[64]; // Array representing value of squares
     int to_move; // 1 fo white and -1 for black
@@ -32,535 +73,3524 @@ typedef struct {
     int en_passant; // En passant target square (0-63) or -1
     int halfmove_clock;
     int fullmove_number;
+    uint64_t peice_bb[13]; // One bitboard per peice, indexed by the Peice enum (EMPTY unused)
+    uint64_t color_bb[2]; // Occupancy of white [0] and black [1] peices
+    uint64_t occupied; // Occupancy of both sides
+    uint64_t hash; // Zobrist key of the position
+    uint64_t pawn_hash; // Zobrist key of the pawns alone, indexes the pawn table
+    uint64_t checkers; // Enemy peices giving check to the side to move
+    int psq_mg; // Material and piece square score from white's view, middlegame and endgame halves
+    int psq_eg;
+    int phase; // Non pawn material left, MAX_PHASE at the start of the game and 0 with bare pawns
+    Accumulator *acc; // Top of the network accumulator stack, NULL when the piece square evaluation is used
+    const Network *net; // Weights the accumulators are built from
 } Board;
 
+#define PYTHON_BOARD_SIZE (offsetof(Board, fullmove_number) + sizeof(int))
+
 // Move Representation
+// 16 bits: start square [0, 6), end square [6, 12), promotion peice type minus W_KNIGHT [12, 14) and kind [14, 16).
+// The moving and captured peices are read from the board, so a move list entry is just this
+typedef uint16_t Move;
+
+#define MOVE_NONE 0 // a1a1, never a legal move
+
+enum MoveKind {
+    MOVE_NORMAL = 0,
+    MOVE_PROMOTION = 1 << 14,
+    MOVE_EN_PASSANT = 2 << 14,
+    MOVE_CASTLING = 3 << 14, // Stored as the king move, the rook follows
+};
+
+static inline Move make_move(int from, int to, int kind){
+    return (Move)(from | (to << 6) | kind);
+}
+
+static inline Move make_promotion(int from, int to, int peice_type){
+    return (Move)(from | (to << 6) | ((peice_type - W_KNIGHT) << 12) | MOVE_PROMOTION);
+}
+
+static inline int move_from(Move move){
+    return move & 0x3F;
+}
+
+static inline int move_to(Move move){
+    return (move >> 6) & 0x3F;
+}
+
+static inline int move_kind(Move move){
+    return move & (3 << 14);
+}
+
+// White peice type promoted to, only meaningful for MOVE_PROMOTION
+static inline int promotion_type(Move move){
+    return ((move >> 12) & 3) + W_KNIGHT;
+}
+
+// What apply_move overwrites and undo_move restores. The search keeps one per ply
+typedef struct {
+    uint64_t hash;
+    uint64_t checkers;
+    int castling_rights;
+    int en_passant;
+    int halfmove_clock;
+    int captured; // Peice taken by the move, EMPTY if none
+} StateInfo;
+
+// Peice move takes, looked up before it is played
+static inline int captured_peice(const Board *board, Move move){
+    if(move_kind(move) == MOVE_EN_PASSANT) return board->to_move == 1 ? B_PAWN : W_PAWN;
+    return board->squares[move_to(move)];
+}
+
+// Captures and promotions, the moves quiescence searches
+static inline bool is_tactical(const Board *board, Move move){
+    return move_kind(move) == MOVE_PROMOTION || captured_peice(board, move) != EMPTY;
+}
+
+typedef std::chrono::steady_clock::time_point TimePoint;
+
+// Time budget of one search, all durations in seconds of wall clock time
+typedef struct {
+    TimePoint start;
+    double soft_limit; // No new iteration is started past this (stretched while the best move is unstable)
+    double hard_limit; // The search is stopped past this, whatever it is doing
+    double last_iteration; // Durations of the last two completed iterations
+    double prev_iteration;
+    double instability; // Decaying count of best move changes at the root
+    uint64_t node_limit; // Nodes of the main thread after which it stops, UINT64_MAX for none
+    int depth_limit; // Last iteration searched, MAX_DEPTH unless a fixed depth is wanted
+} TimeManager;
+
+// State every search thread sees
+typedef struct {
+    std::atomic<bool> stop; // Set once the deadline passes or the main thread is done
+    TimeManager tm; // Only read by the main thread, apart from the depth limit
+} SharedSearch;
+
+// Cached pawn structure terms of one pawn configuration, from white's view
+typedef struct {
+    uint64_t key;
+    int16_t mg;
+    int16_t eg;
+    int8_t shelter[2][8]; // [color][king file], the middlegame penalty for the pawns in front of a king there
+} PawnEntry;
+
+// Counters of one search. Each thread keeps its own and engine_get_stats() adds them up.
+// Building with -DNO_SEARCH_STATS leaves the counters in the search out, and they then stay at 0
+#define NUM_CUTOFF_STAGES 5
+typedef struct {
+    uint64_t nodes;
+    uint64_t qnodes; // Quiescence nodes, part of nodes
+    uint64_t tt_probes;
+    uint64_t tt_hits;
+    uint64_t cutoffs; // Beta cutoffs in the main search
+    uint64_t first_move_cutoffs; // Of those, the ones on the first move searched
+    uint64_t stage_cutoffs[NUM_CUTOFF_STAGES]; // By where the move came from: table move, good captures, killers, quiets, bad captures
+    int depth; // Last completed iteration
+    int seldepth; // Deepest ply reached, quiescence included
+    int score; // Of the best move at depth, side to move's view
+    double time; // Seconds the search took
+    double depth_time[MAX_DEPTH + 1]; // Seconds from the start until the main thread completed each depth
+    char pv[MAX_PLY * 6]; // Principal variation as space separated UCI moves
+} SearchStats;
+
+#if defined(NO_SEARCH_STATS)
+#define STAT(...)
+#else
+#define STAT(...) __VA_ARGS__
+#endif
+
+// Per thread search state, owned by an engine and reused from one search to the next
+typedef struct {
+    Board board; // Private copy of the root position
+    int thread_id; // 0 is the main thread
+    Engine *engine; // Owner of the transposition table and search options
+    SharedSearch *shared;
+    uint64_t nodes;
+    Move killers[MAX_PLY][2]; // Two quiet moves per ply that recently caused a cutoff
+    int history[2][64][64]; // [color][from][to], how often a quiet move caused a cutoff
+    Move best_move; // Result of the deepest completed iteration
+    int best_score;
+    int completed_depth;
+    int best_move_changes; // During the current iteration
+    bool null_move[MAX_PLY]; // The move made at this ply was a null move
+    StateInfo states[MAX_PLY]; // Undo state of the move made at each ply
+    Move move_lists[MAX_PLY][MAX_MOVES]; // Move picker storage of each ply, so a node's frame holds no move list
+    int score_lists[MAX_PLY][MAX_MOVES];
+    SharedSearch local; // Stop flag and limits when this thread searches a position on its own (batches)
+    SearchStats stats; // Counters only, the engine fills in the rest
+    Accumulator accumulators[MAX_PLY + 1]; // One per ply when a network is loaded
+    PawnEntry pawn_table[PAWN_HASH_SIZE];
+} SearchContext;
+
+// Runtime switches for the selective search, so the node and strength effect of each can be measured alone
 typedef struct {
-    int from; // Start square
-    int to; // End Square
-    int peice; // Peice Number assigned by enu,
-    int captured; // Peice Captured in This move
-    int promotion; // Peice Promoted
-    int is_castling;
-    int is_en_passant;
-    int prev_en_passant;
-    int prev_castling_rights;
-    int prev_halfmove_clock;
-} Move;
+    int null_move;
+    int late_move_reductions;
+    int reverse_futility;
+    int futility;
+    int razoring;
+} SearchOptions;
+
+// A move at the root with its score from the current iteration
+typedef struct {
+    Move move;
+    int score;
+} RootMove;
+
+// Passed to engine_create(), zero fields take the defaults
+typedef struct {
+    int hash_mb; // Transposition table size, 0 for DEFAULT_HASH_MB
+    int threads; // Search threads, 0 for 1
+    const char *eval_file; // Network weights, NULL or "" for the piece square evaluation
+} EngineConfig;
 
 // ------- Function Prototypes ---------- //
 
-int generate_moves(Board *board, Move *moves);
-void apply_move(Board *board, Move *move);
-void undo_move(Board *board, Move *move);
-int evaluate_board(Board *board);
-int minimax(Board *board, int depth, int alpha, int beta, int maxmizingPlayer, clock_t end_time);
-int move_heuristic(Board *board, Move *move);
-void sort_moves(Board *board, Move *moves, int num_moves);
+void init_attack_tables();
+void init_zobrist();
+void init_board_state(Board *board);
+uint64_t bishop_attacks(int square, uint64_t occupied);
+uint64_t rook_attacks(int square, uint64_t occupied);
+uint64_t attackers_to(Board *board, int square, uint64_t occupied);
+bool is_square_attacked(Board *board, int square, int side);
+bool in_check(Board *board, int side);
+int generate_moves(Board *board, Move *moves, int type);
+void apply_move(Board *board, Move move, StateInfo *state);
+void undo_move(Board *board, Move move, const StateInfo *state);
+int evaluate_board(Board *board, PawnEntry *pawn_table);
+int negamax(SearchContext *ctx, Board *board, int depth, int alpha, int beta, int ply);
+int quiescence(SearchContext *ctx, Board *board, int alpha, int beta, int ply);
+int see(Board *board, Move move);
+void iterative_deepening(SearchContext *ctx);
+
+extern "C" {
+Engine *engine_create(const EngineConfig *config);
+void engine_destroy(Engine *engine);
+void engine_new_game(Engine *engine);
+void engine_ponder_stop(Engine *engine);
+int engine_set_option(Engine *engine, const char *name, int value);
+int engine_set_book(Engine *engine, const char *path);
+void engine_get_stats(Engine *engine, SearchStats *stats);
+const char *engine_stats_json(Engine *engine);
+const char *engine_search(Engine *engine, const char *fen, const char *moves, double per_move_time, double total_time);
+const char *engine_search_board(Engine *engine, Board *board, double per_move_time, double total_time);
+int engine_search_batch(Engine *engine, int count, const void *boards, const char *const *fens,
+                        const double *time_limits, const uint64_t *node_limits, char (*moves)[6], int *scores, int *evals);
+void engine_init(int hash_mb);
+void set_threads(int threads);
+int set_search_option(const char *name, int value);
+int set_eval_file(const char *path);
+int set_book_file(const char *path);
 const char* choose_best_move(Board *board, double per_move_time, double total_time);
+const char *search_stats_json();
+int load_bitbases(const char *path);
+}
 
 // --------------------- //
 
 // Global variables
-char notation_buffer[6]; // Buffer to hold the notation of the best move
-
-bool is_square_attacked(Board *board, int square, int side) {
-    // Iterate through all opponent pieces
-    for (int i = 0; i < 64; i++) {
-        int piece = board->squares[i];
-        if (piece == EMPTY || (side == 1 && piece >= W_PAWN && piece <= W_KING) || 
-            (side == -1 && piece >= B_PAWN && piece <= B_KING)) {
-            continue;
+int reductions[64][64]; // Late move reduction in plies by [depth][move number]
+
+// ------- Bitboards ---------- //
+
+#define FILE_A 0x0101010101010101ULL
+#define FILE_H 0x8080808080808080ULL
+#define RANK_1 0x00000000000000FFULL
+#define RANK_3 0x0000000000FF0000ULL
+#define RANK_6 0x0000FF0000000000ULL
+#define RANK_8 0xFF00000000000000ULL
+
+#define SQUARE_BB(sq) (1ULL << (sq))
+#define COLOR_INDEX(side) ((side) == 1 ? 0 : 1)
+#define PEICE_COLOR(peice) ((peice) >= B_PAWN ? 1 : 0)
+#define PEICE_TYPE(peice) ((peice) > W_KING ? (peice) - W_KING : (peice))
+
+static inline int lsb(uint64_t bb){
+    return __builtin_ctzll(bb);
+}
+
+static inline int pop_lsb(uint64_t *bb){
+    int square = __builtin_ctzll(*bb);
+    *bb &= *bb - 1;
+    return square;
+}
+
+static inline int popcount(uint64_t bb){
+    return __builtin_popcountll(bb);
+}
+
+// Precomputed attack tables for the non sliding peices
+uint64_t knight_attacks[64];
+uint64_t king_attacks[64];
+uint64_t pawn_attacks[2][64]; // [color][square]
+uint64_t between_bb[64][64]; // Squares strictly between two aligned squares
+uint64_t line_bb[64][64]; // Whole rank, file or diagonal through two aligned squares
+
+// Magic bitboard entry for one square of a sliding peice
+typedef struct {
+    uint64_t mask; // Relevant blocker squares (board edges excluded)
+    uint64_t magic;
+    uint64_t *attacks; // Slice of the shared attack table for this square
+    int shift;
+} Magic;
+
+Magic bishop_magics[64];
+Magic rook_magics[64];
+uint64_t bishop_table[0x1480];
+uint64_t rook_table[0x19000];
+
+static inline unsigned magic_index(const Magic *m, uint64_t occupied){
+#if defined(USE_PEXT)
+    return (unsigned)_pext_u64(occupied, m->mask);
+#else
+    return (unsigned)(((occupied & m->mask) * m->magic) >> m->shift);
+#endif
+}
+
+uint64_t bishop_attacks(int square, uint64_t occupied){
+    const Magic *m = &bishop_magics[square];
+    return m->attacks[magic_index(m, occupied)];
+}
+
+uint64_t rook_attacks(int square, uint64_t occupied){
+    const Magic *m = &rook_magics[square];
+    return m->attacks[magic_index(m, occupied)];
+}
+
+static inline uint64_t queen_attacks(int square, uint64_t occupied){
+    return bishop_attacks(square, occupied) | rook_attacks(square, occupied);
+}
+
+// Walks each ray one square at a time, only used to fill the tables
+static uint64_t sliding_attacks(int square, uint64_t occupied, const int (*deltas)[2]){
+    uint64_t attacks = 0;
+    for(int d=0; d<4; d++){
+        int rank = square / 8 + deltas[d][0];
+        int file = square % 8 + deltas[d][1];
+        while(rank >= 0 && rank < 8 && file >= 0 && file < 8){
+            uint64_t bb = SQUARE_BB(rank * 8 + file);
+            attacks |= bb;
+            if(occupied & bb) break;
+            rank += deltas[d][0];
+            file += deltas[d][1];
         }
+    }
+    return attacks;
+}
 
-        // Generate moves for the opponent piece
-        Move moves[MAX_MOVES];
-        Board temp_board = *board;
-        temp_board.to_move = -side; // Temporarily switch sides for move generation
-        int num_moves = generate_moves(&temp_board, moves);
+// Deterministic xorshift generator so every process finds the same magics
+static uint64_t magic_rand(uint64_t *state){
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
 
-        // Check if any move attacks the square
-        for (int j = 0; j < num_moves; j++) {
-            if (moves[j].to == square) {
-                return true;
+static void init_magics(Magic *magics, uint64_t *table, const int (*deltas)[2]){
+    static uint64_t occupancy[4096], reference[4096];
+    uint64_t *next_slice = table;
+#if !defined(USE_PEXT)
+    static int epoch[4096];
+    int current = 0;
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+#endif
+
+    for(int sq=0; sq<64; sq++){
+        Magic *m = &magics[sq];
+        // Edge squares never change the attack set, unless the peice stands on that edge
+        uint64_t edges = 0;
+        if(sq / 8 != 0) edges |= RANK_1;
+        if(sq / 8 != 7) edges |= RANK_8;
+        if(sq % 8 != 0) edges |= FILE_A;
+        if(sq % 8 != 7) edges |= FILE_H;
+
+        m->mask = sliding_attacks(sq, 0, deltas) & ~edges;
+        m->shift = 64 - popcount(m->mask);
+        m->attacks = next_slice;
+
+        // Enumerate every blocker subset of the mask (Carry-Rippler)
+        int size = 0;
+        uint64_t subset = 0;
+        do{
+            occupancy[size] = subset;
+            reference[size] = sliding_attacks(sq, subset, deltas);
+            size++;
+            subset = (subset - m->mask) & m->mask;
+        } while(subset);
+        next_slice += size;
+
+#if defined(USE_PEXT)
+        for(int i=0; i<size; i++){
+            m->attacks[_pext_u64(occupancy[i], m->mask)] = reference[i];
+        }
+#else
+        // Try sparse random numbers until one maps every subset without destructive collisions
+        for(int i=0; i<size; ){
+            do{
+                m->magic = magic_rand(&seed) & magic_rand(&seed) & magic_rand(&seed);
+            } while(popcount((m->mask * m->magic) >> 56) < 6);
+
+            current++;
+            for(i=0; i<size; i++){
+                unsigned index = magic_index(m, occupancy[i]);
+                if(epoch[index] < current){
+                    epoch[index] = current;
+                    m->attacks[index] = reference[i];
+                }
+                else if(m->attacks[index] != reference[i]){
+                    break;
+                }
             }
         }
+#endif
     }
-    return false;
 }
 
-// Generate all legal moves for current board position
-int generate_moves(Board *board, Move *moves){
-    int num_moves = 0;
-    int direction, start, end;
-    int side = board->to_move;
-    int opponent = -board->to_move;
+void init_attack_tables(){
+    static const int bishop_deltas[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+    static const int rook_deltas[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    static const int knight_deltas[8][2] = {{-2, -1}, {-2, 1}, {-1, -2}, {-1, 2}, {1, -2}, {1, 2}, {2, -1}, {2, 1}};
+    static const int king_deltas[8][2] = {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}};
+
+    for(int sq=0; sq<64; sq++){
+        int rank = sq / 8, file = sq % 8;
+        knight_attacks[sq] = king_attacks[sq] = 0;
+        for(int d=0; d<8; d++){
+            int r = rank + knight_deltas[d][0], f = file + knight_deltas[d][1];
+            if(r >= 0 && r < 8 && f >= 0 && f < 8) knight_attacks[sq] |= SQUARE_BB(r * 8 + f);
+            r = rank + king_deltas[d][0];
+            f = file + king_deltas[d][1];
+            if(r >= 0 && r < 8 && f >= 0 && f < 8) king_attacks[sq] |= SQUARE_BB(r * 8 + f);
+        }
+        uint64_t bb = SQUARE_BB(sq);
+        pawn_attacks[0][sq] = ((bb & ~FILE_A) << 7) | ((bb & ~FILE_H) << 9);
+        pawn_attacks[1][sq] = ((bb & ~FILE_A) >> 9) | ((bb & ~FILE_H) >> 7);
+    }
 
-    for(int i=0; i<64; i++){
-        int peice = board->squares[i];
-        if(peice == EMPTY) continue;
-        if((side == 1 && peice >= W_PAWN && peice <= W_KING)||(side == -1 && peice >= B_PAWN && peice <= B_KING)){
-            switch(peice){
-                case W_PAWN:
-                case B_PAWN:
-                    // Pawn Moves
-                    {
-                        // Move Type-1 (Forward Moves)
-                        direction = (side == 1) ? 8 : -8;
-                        start = i;
-                        end = start + direction;
-                        if(end >=0 && end<64 && board->squares[end] == EMPTY){
-                            //Registering Normal Move
-                            moves[num_moves] = (Move){start, end, peice, EMPTY, EMPTY, 0, 0, board->en_passant, board->castling_rights, board->halfmove_clock};
-                            num_moves++;
-
-                            // Checking double moves from starting position
-                            if((side == 1 && i/8 == 1) || (side == -1 && i/8 == 6)){
-                                end += direction;
-                                if(board->squares[end] == EMPTY){
-                                    moves[num_moves] = (Move){start, end, peice, EMPTY, EMPTY, 0, 0, board->en_passant, board->castling_rights, board->halfmove_clock};
-                                    num_moves++;
-                                }
-                            }
-
-                        }
-
-                        // Move Type-2 (Captures + En Passant)
-                        int capture_dirs[] = {-1, 1};
-                        for(auto capture_dir : capture_dirs){
-                            end = start + direction + capture_dir;
-                            if(end>=0 && end<64 && (end%8 != 7 || capture_dir != -side) &&(end %8 == 0 || capture_dir != side)){
-                                int target = board->squares[end];
-                                if((target != EMPTY) && (side == 1 && target >= B_PAWN) &&(side == -1 && target >= W_PAWN && target <= W_KING)){
-                                    moves[num_moves] = (Move){start, end, peice, target, EMPTY, 0, board->en_passant, board->castling_rights, board->halfmove_clock};
-                                    num_moves++;
-                                }
-
-                                // En Passant
-                                if(end == board->en_passant){
-                                    moves[num_moves] = (Move){start, end, peice, (side==1)? B_PAWN : W_PAWN, EMPTY, 0, 1, board->en_passant, board->castling_rights, board->halfmove_clock};
-                                    num_moves++;
-                                }
-                            }
-                        }
-                    }
-                    break;
+    init_magics(bishop_magics, bishop_table, bishop_deltas);
+    init_magics(rook_magics, rook_table, rook_deltas);
 
-                case W_KNIGHT:
-                case B_KNIGHT:
-                    // Knight Moves
-                    {
-                        int knight_moves[8] = {-17, -15, -10, -6, 6, 10, 15, 17};
-                        start = i;
-                        for(auto knight_move : knight_moves){
-                            end = start + knight_move;
-                            if(end >= 0 && end < 64 && abs((end % 8) - (start % 8)) <= 2){
-                                int target = board->squares[end];
-                                if((target == EMPTY) || (side == 1 && target >=B_PAWN) ||(side == -1 && target >= W_PAWN && target <= W_KING)){
-                                    moves[num_moves] = (Move){start, end, peice, target, EMPTY, 0, 0, board->en_passant, board->castling_rights, board->halfmove_clock};
-                                    num_moves++;
-                                }
-                            }
-                        }
-                    }
-                    break;
-                
-                case W_BISHOP:
-                case W_ROOK:
-                case W_QUEEN:
-                case B_BISHOP:
-                case B_ROOK:
-                case B_QUEEN:
-                    // Sliding Peices
-                    {
-                        int directions[8];
-                        int num_directions = 0;
-                        if(peice == W_BISHOP || peice == B_BISHOP){
-                            int dirs[] = {-9, -7, 7, 9};
-                            memcpy(directions, dirs, sizeof(dirs));
-                            num_directions = 4;
-                        }
-                        else if(peice == W_ROOK || peice == B_ROOK){
-                            int dirs[] = {-8, -1, 1, 8};
-                            memcpy(directions, dirs, sizeof(dirs));
-                            num_directions = 4;
-                        }
-                        else if(peice == W_QUEEN || peice == B_QUEEN){
-                            int dirs[] = {-9, -8, -1, 1, 8, 9};
-                            memcpy(directions, dirs, sizeof(dirs));
-                            num_directions = 8;
-                        }
-
-                        for(auto direction : directions){
-                            start = i;
-                            end = i;
-                            while(1){
-                                int rank = end / 8;
-                                int file = end%8;
-                                end += direction; 
-                                if(end<0 || end >= 64) break;
-                                int end_rank = end / 8;
-                                int end_file = end % 8;
-
-                                // Prevent Warping
-                                if(abs(end_file - file) > 1 || abs(end_rank - rank) > 1) break;
-                                int target = board->squares[end];
-
-                                if((target == EMPTY) || (side == 1 && target >= B_PAWN) ||(side == -1 && target >= W_PAWN && target <= W_KING)){
-                                    moves[num_moves] = (Move) {start, end, peice, target, EMPTY, 0, 0, board->en_passant, board->castling_rights, board->halfmove_clock};
-                                    num_moves++;
-                                    if(target != EMPTY) break;
-                                }
-                            }
-                        }
-                    }
-                    break;
-                case W_KING:
-                case B_KING:
-                    // King Moves
-                    {
-                        int directions[8] = {-9, -8, -7, -1, 1, 7 ,8, 9};
-                        start = i;
-                        for(auto direction : directions){
-                            end = start + direction;
-                            if(end >= 0 && end < 64 && abs((start%8) - (end % 8)) <= 1){
-                                int target = board->squares[end];
-                                if((target == EMPTY) || (side == 1 && target >= B_PAWN) || (side == -1 && target >= W_PAWN && target <= W_KING)){
-                                    moves[num_moves] = (Move){start, end, peice, target, EMPTY, 0, 0, board->en_passant, board->castling_rights, board->halfmove_clock};
-                                    num_moves++;
-                                }
-                            }
-                        }
-
-                        // Castling(Simplified doesnt check that if squares under attack)
-                        if((side == 1 && peice == W_KING) || (side == -1 && peice == B_KING)){
-                            // Kingside Castling
-                            if (board->castling_rights & (side == 1 ? 0x1 : 0x4)) {
-                                if(!is_square_attacked(board, start, side) && !is_square_attacked(board, start + 1, side) && !is_square_attacked(board, start + 2, side)){
-                                    if((board->squares[start + 1] == EMPTY) && (board->squares[start + 2] == EMPTY) && (board->squares[start+3] == ((side == 1) ? W_ROOK : B_ROOK))){
-                                        moves[num_moves] = (Move){start, start + 2, peice, EMPTY, EMPTY, 1, 0, board->en_passant, board->castling_rights, board->halfmove_clock };
-                                        num_moves++;
-                                    }
-                                }
-                            }
-
-                            // Queenside Castling
-                            if(board->castling_rights & (side == 1 ? 0x2 : 0x8)){
-                                if(!is_square_attacked(board, start, side) && !is_square_attacked(board, start - 1, side) && !is_square_attacked(board, start - 2, side)){
-                                    if((board->squares[start - 1] == EMPTY) && (board->squares[start - 2] == EMPTY) && (board->squares[start - 3] == EMPTY) && (board->squares[start-4] == ((side == 1) ? W_ROOK : B_ROOK))){
-                                        moves[num_moves] = (Move){start, start - 2, peice, EMPTY, EMPTY, 1, 0, board->en_passant, board->castling_rights, board->halfmove_clock };
-                                        num_moves++;
-                                    }
-                                }
-                            }
-                        }
-                    }
-                    break;
+    for(int a=0; a<64; a++){
+        for(int b=0; b<64; b++){
+            between_bb[a][b] = line_bb[a][b] = 0;
+            if(a == b) continue;
+            if(bishop_attacks(a, 0) & SQUARE_BB(b)){
+                between_bb[a][b] = bishop_attacks(a, SQUARE_BB(b)) & bishop_attacks(b, SQUARE_BB(a));
+                line_bb[a][b] = (bishop_attacks(a, 0) & bishop_attacks(b, 0)) | SQUARE_BB(a) | SQUARE_BB(b);
+            }
+            else if(rook_attacks(a, 0) & SQUARE_BB(b)){
+                between_bb[a][b] = rook_attacks(a, SQUARE_BB(b)) & rook_attacks(b, SQUARE_BB(a));
+                line_bb[a][b] = (rook_attacks(a, 0) & rook_attacks(b, 0)) | SQUARE_BB(a) | SQUARE_BB(b);
             }
         }
     }
-    return num_moves;
 }
 
-void apply_move(Board *board, Move *move){
-    //Save Previous State
-    move->prev_en_passant = board->en_passant;
-    move->prev_castling_rights = board->castling_rights;
-    move->prev_halfmove_clock = board->halfmove_clock;
-
-    board->en_passant = -1;
+// ------- Zobrist Hashing ---------- //
 
-    //Move the Peice
-    board->squares[move->to] = move->peice;
-    board->squares[move->from] = EMPTY;
+uint64_t zobrist_peice[13][64];
+uint64_t zobrist_castling[16];
+uint64_t zobrist_en_passant[8]; // Indexed by file
+uint64_t zobrist_side; // Black to move
+uint64_t zobrist_no_pawns; // Pawn key of a position without pawns, nonzero so it never matches an empty pawn table slot
 
-    //Handle Captures
-    if(move->captured != EMPTY){
-        board->halfmove_clock = 0;
+void init_zobrist(){
+    uint64_t seed = 0x2545F4914F6CDD1DULL;
+    for(int peice=W_PAWN; peice<=B_KING; peice++){
+        for(int sq=0; sq<64; sq++){
+            zobrist_peice[peice][sq] = magic_rand(&seed);
+        }
     }
-
-    //Handle double pawn move (set en passant target)
-    if(((move->peice == W_PAWN) || (move->peice == B_PAWN)) && abs(move->from - move->to) == 16 ){
-        board->en_passant = (move->from + move-> to)/2;
+    // Each castling mask gets the xor of its bits so rights can be cleared one at a time
+    uint64_t rights[4];
+    for(int i=0; i<4; i++) rights[i] = magic_rand(&seed);
+    for(int mask=0; mask<16; mask++){
+        zobrist_castling[mask] = 0;
+        for(int i=0; i<4; i++){
+            if(mask & (1 << i)) zobrist_castling[mask] ^= rights[i];
+        }
     }
+    for(int file=0; file<8; file++) zobrist_en_passant[file] = magic_rand(&seed);
+    zobrist_side = magic_rand(&seed);
+    zobrist_no_pawns = magic_rand(&seed);
+}
+
+// ------- Piece Square Tables ---------- //
+// Middlegame and endgame values (PeSTO), drawn from white's side with a8 first, so a white peice on
+// square sq reads entry sq ^ 56 and a black peice reads entry sq
+
+const int MG_VALUES[7] = {0, 82, 337, 365, 477, 1025, 0};
+const int EG_VALUES[7] = {0, 94, 281, 297, 512, 936, 0};
+const int PHASE_WEIGHTS[7] = {0, 0, 1, 1, 2, 4, 0}; // Full middlegame is 24
+#define MAX_PHASE 24
+
+const int MG_TABLES[7][64] = {
+    {0},
+    { // Pawn
+          0,   0,   0,   0,   0,   0,  0,   0,
+         98, 134,  61,  95,  68, 126, 34, -11,
+         -6,   7,  26,  31,  65,  56, 25, -20,
+        -14,  13,   6,  21,  23,  12, 17, -23,
+        -27,  -2,  -5,  12,  17,   6, 10, -25,
+        -26,  -4,  -4, -10,   3,   3, 33, -12,
+        -35,  -1, -20, -23, -15,  24, 38, -22,
+          0,   0,   0,   0,   0,   0,  0,   0,
+    },
+    { // Knight
+        -167, -89, -34, -49,  61, -97, -15, -107,
+         -73, -41,  72,  36,  23,  62,   7,  -17,
+         -47,  60,  37,  65,  84, 129,  73,   44,
+          -9,  17,  19,  53,  37,  69,  18,   22,
+         -13,   4,  16,  13,  28,  19,  21,   -8,
+         -23,  -9,  12,  10,  19,  17,  25,  -16,
+         -29, -53, -12,  -3,  -1,  18, -14,  -19,
+        -105, -21, -58, -33, -17, -28, -19,  -23,
+    },
+    { // Bishop
+        -29,   4, -82, -37, -25, -42,   7,  -8,
+        -26,  16, -18, -13,  30,  59,  18, -47,
+        -16,  37,  43,  40,  35,  50,  37,  -2,
+         -4,   5,  19,  50,  37,  37,   7,  -2,
+         -6,  13,  13,  26,  34,  12,  10,   4,
+          0,  15,  15,  15,  14,  27,  18,  10,
+          4,  15,  16,   0,   7,  21,  33,   1,
+        -33,  -3, -14, -21, -13, -12, -39, -21,
+    },
+    { // Rook
+         32,  42,  32,  51, 63,  9,  31,  43,
+         27,  32,  58,  62, 80, 67,  26,  44,
+         -5,  19,  26,  36, 17, 45,  61,  16,
+        -24, -11,   7,  26, 24, 35,  -8, -20,
+        -36, -26, -12,  -1,  9, -7,   6, -23,
+        -45, -25, -16, -17,  3,  0,  -5, -33,
+        -44, -16, -20,  -9, -1, 11,  -6, -71,
+        -19, -13,   1,  17, 16,  7, -37, -26,
+    },
+    { // Queen
+        -28,   0,  29,  12,  59,  44,  43,  45,
+        -24, -39,  -5,   1, -16,  57,  28,  54,
+        -13, -17,   7,   8,  29,  56,  47,  57,
+        -27, -27, -16, -16,  -1,  17,  -2,   1,
+         -9, -26,  -9, -10,  -2,  -4,   3,  -3,
+        -14,   2, -11,  -2,  -5,   2,  14,   5,
+        -35,  -8,  11,   2,   8,  15,  -3,   1,
+         -1, -18,  -9,  10, -15, -25, -31, -50,
+    },
+    { // King
+        -65,  23,  16, -15, -56, -34,   2,  13,
+         29,  -1, -20,  -7,  -8,  -4, -38, -29,
+         -9,  24,   2, -16, -20,   6,  22, -22,
+        -17, -20, -12, -27, -30, -25, -14, -36,
+        -49,  -1, -27, -39, -46, -44, -33, -51,
+        -14, -14, -22, -46, -44, -30, -15, -27,
+          1,   7,  -8, -64, -43, -16,   9,   8,
+        -15,  36,  12, -54,   8, -28,  24,  14,
+    },
+};
+
+const int EG_TABLES[7][64] = {
+    {0},
+    { // Pawn
+          0,   0,   0,   0,   0,   0,   0,   0,
+        178, 173, 158, 134, 147, 132, 165, 187,
+         94, 100,  85,  67,  56,  53,  82,  84,
+         32,  24,  13,   5,  -2,   4,  17,  17,
+         13,   9,  -3,  -7,  -7,  -8,   3,  -1,
+          4,   7,  -6,   1,   0,  -5,  -1,  -8,
+         13,   8,   8,  10,  13,   0,   2,  -7,
+          0,   0,   0,   0,   0,   0,   0,   0,
+    },
+    { // Knight
+        -58, -38, -13, -28, -31, -27, -63, -99,
+        -25,  -8, -25,  -2,  -9, -25, -24, -52,
+        -24, -20,  10,   9,  -1,  -9, -19, -41,
+        -17,   3,  22,  22,  22,  11,   8, -18,
+        -18,  -6,  16,  25,  16,  17,   4, -18,
+        -23,  -3,  -1,  15,  10,  -3, -20, -22,
+        -42, -20, -10,  -5,  -2, -20, -23, -44,
+        -29, -51, -23, -15, -22, -18, -50, -64,
+    },
+    { // Bishop
+        -14, -21, -11,  -8, -7,  -9, -17, -24,
+         -8,  -4,   7, -12, -3, -13,  -4, -14,
+          2,  -8,   0,  -1, -2,   6,   0,   4,
+         -3,   9,  12,   9, 14,  10,   3,   2,
+         -6,   3,  13,  19,  7,  10,  -3,  -9,
+        -12,  -3,   8,  10, 13,   3,  -7, -15,
+        -14, -18,  -7,  -1,  4,  -9, -15, -27,
+        -23,  -9, -23,  -5, -9, -16,  -5, -17,
+    },
+    { // Rook
+        13, 10, 18, 15, 12,  12,   8,   5,
+        11, 13, 13, 11, -3,   3,   8,   3,
+         7,  7,  7,  5,  4,  -3,  -5,  -3,
+         4,  3, 13,  1,  2,   1,  -1,   2,
+         3,  5,  8,  4, -5,  -6,  -8, -11,
+        -4,  0, -5, -1, -7, -12,  -8, -16,
+        -6, -6,  0,  2, -9,  -9, -11,  -3,
+        -9,  2,  3, -1, -5, -13,   4, -20,
+    },
+    { // Queen
+         -9,  22,  22,  27,  27,  19,  10,  20,
+        -17,  20,  32,  41,  58,  25,  30,   0,
+        -20,   6,   9,  49,  47,  35,  19,   9,
+          3,  22,  24,  45,  57,  40,  57,  36,
+        -18,  28,  19,  47,  31,  34,  39,  23,
+        -16, -27,  15,   6,   9,  17,  10,   5,
+        -22, -23, -30, -16, -16, -23, -36, -32,
+        -33, -28, -22, -43,  -5, -32, -20, -41,
+    },
+    { // King
+        -74, -35, -18, -18, -11,  15,   4, -17,
+        -12,  17,  14,  17,  17,  38,  23,  11,
+         10,  17,  23,  15,  20,  45,  44,  13,
+         -8,  22,  24,  27,  26,  33,  26,   3,
+        -18,  -4,  21,  24,  27,  23,   9, -11,
+        -19,  -3,  11,  21,  23,  16,   7,  -9,
+        -27, -11,   4,  13,  14,   4,  -5, -17,
+        -53, -34, -21, -11, -28, -14, -24, -43,
+    },
+};
 
-    //Handling en_passant pawn capture
-    if(move->is_en_passant){
-        int captured_pawn_pos = move->to + ((board->to_move == 1) ? 8 : -8);
-        board->squares[captured_pawn_pos] = EMPTY;
+// Material plus table value of every peice on every square, positive for white and negative for black
+int psq_mg[13][64];
+int psq_eg[13][64];
+
+void init_psqt(){
+    for(int type=W_PAWN; type<=W_KING; type++){
+        for(int sq=0; sq<64; sq++){
+            psq_mg[type][sq] = MG_VALUES[type] + MG_TABLES[type][sq ^ 56];
+            psq_eg[type][sq] = EG_VALUES[type] + EG_TABLES[type][sq ^ 56];
+            psq_mg[type + W_KING][sq] = -(MG_VALUES[type] + MG_TABLES[type][sq]);
+            psq_eg[type + W_KING][sq] = -(EG_VALUES[type] + EG_TABLES[type][sq]);
+        }
     }
+}
+
+// --------------------- //
+
+// ------- Pawn Structure ---------- //
+// Pawn terms only depend on where the pawns are, so they are cached in a pawn table under board->pawn_hash.
+// Middlegame and endgame halves are from white's view like psq_mg/psq_eg.
+
+#define FILE_BB(file) (FILE_A << (file))
+
+const int PASSED_MG[8] = {0, 0, 5, 10, 20, 35, 60, 0}; // By rank counted from the pawn's own side
+const int PASSED_EG[8] = {0, 10, 15, 25, 45, 70, 110, 0};
+const int ISOLATED_MG = -10, ISOLATED_EG = -15;
+const int DOUBLED_MG = -10, DOUBLED_EG = -20; // Per pawn behind another one of the same colour
+const int BACKWARD_MG = -8, BACKWARD_EG = -10;
+const int SHELTER[8] = {-36, 0, -10, -25, -30, -30, -30, 0}; // Nearest own pawn on a file by rank, [0] is no pawn
 
-    //Handling Pawn promotions
-    if(move->promotion != EMPTY){
-        board->squares[move->to] = move->promotion;
+uint64_t forward_ranks[2][64]; // Every rank in front of the square for that colour
+uint64_t passed_mask[2][64]; // Squares in front on the same and adjacent files, no enemy pawn there means passed
+uint64_t adjacent_files[8];
+
+void init_pawn_masks(){
+    for(int file=0; file<8; file++){
+        adjacent_files[file] = (file > 0 ? FILE_BB(file - 1) : 0) | (file < 7 ? FILE_BB(file + 1) : 0);
+    }
+    for(int sq=0; sq<64; sq++){
+        int rank = sq / 8;
+        forward_ranks[0][sq] = rank == 7 ? 0 : ~0ULL << (8 * (rank + 1));
+        forward_ranks[1][sq] = (1ULL << (8 * rank)) - 1;
+        for(int color=0; color<2; color++){
+            passed_mask[color][sq] = forward_ranks[color][sq] & (FILE_BB(sq % 8) | adjacent_files[sq % 8]);
+        }
     }
+}
 
-    // Handle Castling_rights
-    if (move->peice == W_KING) {
-        board->castling_rights &= ~0x3; // Clear white castling rights
-    } else if (move->peice == B_KING) {
-        board->castling_rights &= ~0xC; // Clear black castling rights
-    } else if (move->peice == W_ROOK) {
-        if (move->from == 7) board->castling_rights &= ~0x1; // H1 rook moved
-        else if (move->from == 0) board->castling_rights &= ~0x2; // A1 rook moved
-    } else if (move->peice == B_ROOK) {
-        if (move->from == 63) board->castling_rights &= ~0x4; // H8 rook moved
-        else if (move->from == 56) board->castling_rights &= ~0x8; // A8 rook moved
+// Shelter penalty of the three files around a king on king_file (kept off the edge so it is always three)
+static int king_shelter(uint64_t own_pawns, int color, int king_file){
+    int center = king_file < 1 ? 1 : king_file > 6 ? 6 : king_file;
+    int penalty = 0;
+    for(int file=center - 1; file<=center + 1; file++){
+        uint64_t pawns = own_pawns & FILE_BB(file);
+        int rank = 0;
+        if(pawns){
+            // The pawn closest to our own back rank
+            int sq = color == 0 ? lsb(pawns) : 63 - __builtin_clzll(pawns);
+            rank = color == 0 ? sq / 8 : 7 - sq / 8;
+        }
+        penalty += SHELTER[rank];
     }
+    return penalty;
+}
 
-    //Handle Castling Move
-    if(move->is_castling){
-        if(move->to == move->from + 2){
-            //Kingside castling
-            board->squares[move->from + 1] = board->squares[move->from + 3];
-            board->squares[move->from + 3] = EMPTY;
+// Fills entry with the pawn terms of board
+static void evaluate_pawns(Board *board, PawnEntry *entry){
+    int mg[2] = {0, 0};
+    int eg[2] = {0, 0};
+    for(int color=0; color<2; color++){
+        uint64_t own = board->peice_bb[color == 0 ? W_PAWN : B_PAWN];
+        uint64_t enemy = board->peice_bb[color == 0 ? B_PAWN : W_PAWN];
+        uint64_t pawns = own;
+        while(pawns){
+            int sq = pop_lsb(&pawns);
+            int file = sq % 8;
+            int rank = color == 0 ? sq / 8 : 7 - sq / 8;
+
+            if(!(passed_mask[color][sq] & enemy) && !(forward_ranks[color][sq] & FILE_BB(file) & own)){
+                mg[color] += PASSED_MG[rank];
+                eg[color] += PASSED_EG[rank];
+            }
+            if(forward_ranks[color][sq] & FILE_BB(file) & own){
+                mg[color] += DOUBLED_MG;
+                eg[color] += DOUBLED_EG;
+            }
+            if(!(adjacent_files[file] & own)){
+                mg[color] += ISOLATED_MG;
+                eg[color] += ISOLATED_EG;
+            }
+            // No neighbour level with or behind it to come up in support, and it cannot advance safely
+            else if(!(adjacent_files[file] & own & ~forward_ranks[color][sq])){
+                int stop = sq + (color == 0 ? 8 : -8);
+                if(pawn_attacks[color][stop] & enemy){
+                    mg[color] += BACKWARD_MG;
+                    eg[color] += BACKWARD_EG;
+                }
+            }
         }
-        else if(move->to == move->from - 2){
-            board->squares[move->from -1] = board->squares[move->from-4];
-            board->squares[move->from-4] = EMPTY;
+        for(int file=0; file<8; file++){
+            entry->shelter[color][file] = king_shelter(own, color, file);
         }
     }
+    entry->key = board->pawn_hash;
+    entry->mg = mg[0] - mg[1];
+    entry->eg = eg[0] - eg[1];
+}
 
-    //Update Turn
-    board->to_move = - board->to_move;
+// Pawn terms of board from the table, computed and stored on a miss. Without a table scratch is filled instead
+static inline const PawnEntry *probe_pawns(Board *board, PawnEntry *table, PawnEntry *scratch){
+    PawnEntry *entry = table ? &table[board->pawn_hash & (PAWN_HASH_SIZE - 1)] : scratch;
+    if(!table || entry->key != board->pawn_hash) evaluate_pawns(board, entry);
+    return entry;
+}
 
-    //Update Halfmove Clock
-    if(move->peice == W_PAWN || move->peice == B_PAWN || move->captured != EMPTY){
-        board->halfmove_clock = 0;
-    }
-    else{
-        board->halfmove_clock++;
-    }
+// --------------------- //
 
-    if(board->to_move == 1){
-        board->fullmove_number++;
+// Tables are filled once when the library is loaded
+// Reductions grow with the log of both the remaining depth and the move number
+void init_reductions(){
+    for(int depth=0; depth<64; depth++){
+        for(int move=0; move<64; move++){
+            reductions[depth][move] = (depth && move) ? (int)(0.75 + log((double)depth) * log((double)move) / 2.25) : 0;
+        }
     }
 }
 
-void undo_move(Board *board, Move *move){
-    board->en_passant = move->prev_en_passant;
-    board->castling_rights = move->prev_castling_rights;
-    board->halfmove_clock = move->prev_halfmove_clock;
+static struct AttackTablesInit {
+    AttackTablesInit(){
+        init_reductions();
+        init_psqt();
+        init_pawn_masks();
+        init_attack_tables();
+        init_zobrist();
+    }
+} attack_tables_init;
+
+// ------- NNUE Evaluation ---------- //
+// Optional replacement for the piece square evaluation, a 768 -> NNUE_HIDDEN x 2 -> 1 network.
+// Each side has its own accumulator (the first layer output) seen from its own side of the board,
+// and both are updated peice by peice as moves are made instead of being recomputed at every node.
+//
+// Weight file, little endian int16 after an 8 byte header ("CNUE" then the uint32 hidden size):
+// feature_weights[768][NNUE_HIDDEN], feature_bias[NNUE_HIDDEN], output_weights[2 * NNUE_HIDDEN], output_bias
+
+#define NNUE_FEATURES 768 // (own or enemy) x 6 peice types x 64 squares
+#define NNUE_QA 255 // Clipped ReLU ceiling, the scale of the first layer
+#define NNUE_QB 64 // Scale of the output layer
+#define NNUE_SCALE 400 // Centipawns per unit of network output
+
+struct Network {
+    const int16_t *feature_weights;
+    const int16_t *feature_bias;
+    const int16_t *output_weights; // Side to move half first, then the other side
+    int output_bias;
+    void *mapping; // The whole file, the weights point into it
+    size_t mapping_size;
+};
 
-    board->squares[move->from] = move->peice;
-    board->squares[move->to] = move->captured;
+// Row of the first layer weights for a peice seen from perspective (0 white, 1 black), black sees the board flipped
+static inline const int16_t *nnue_feature(const Network *net, int perspective, int peice, int square){
+    int relative = PEICE_COLOR(peice) != perspective;
+    int sq = perspective ? square ^ 56 : square;
+    return net->feature_weights + ((relative * 6 + PEICE_TYPE(peice) - 1) * 64 + sq) * NNUE_HIDDEN;
+}
 
-    // Rest is en_passant capture
-    if(move->is_en_passant){
-        int captures_pawn_pos = move->to + ((board->to_move == 1) ? 8 : -8);
-        board->squares[captures_pawn_pos] = (board->to_move == 1) ? B_PAWN : W_PAWN;
+// values += add - sub over one accumulator half, either row may be NULL. The NULLs are constants where this is
+// inlined, so each caller gets a single pass over the row. int16 wraps the same way on every path
+static inline void nnue_update(int16_t *values, const int16_t *add, const int16_t *sub){
+#if defined(__AVX2__)
+    for(int i=0; i<NNUE_HIDDEN; i+=16){
+        __m256i v = _mm256_loadu_si256((const __m256i *)(values + i));
+        if(add) v = _mm256_add_epi16(v, _mm256_loadu_si256((const __m256i *)(add + i)));
+        if(sub) v = _mm256_sub_epi16(v, _mm256_loadu_si256((const __m256i *)(sub + i)));
+        _mm256_storeu_si256((__m256i *)(values + i), v);
+    }
+#elif defined(__SSE2__)
+    for(int i=0; i<NNUE_HIDDEN; i+=8){
+        __m128i v = _mm_loadu_si128((const __m128i *)(values + i));
+        if(add) v = _mm_add_epi16(v, _mm_loadu_si128((const __m128i *)(add + i)));
+        if(sub) v = _mm_sub_epi16(v, _mm_loadu_si128((const __m128i *)(sub + i)));
+        _mm_storeu_si128((__m128i *)(values + i), v);
+    }
+#else
+    for(int i=0; i<NNUE_HIDDEN; i++){
+        if(add) values[i] += add[i];
+        if(sub) values[i] -= sub[i];
     }
+#endif
+}
 
-    //Reset Castling Move
-    if(move->is_castling){
-        if(move->to == move->from + 2){
-            //Kingside castling
-            board->squares[move->from + 3] = board->squares[move->from + 1];
-            board->squares[move->from + 1] = EMPTY;
-        }
-        else if(move->to == move->from - 2){
-            board->squares[move->from -4] = board->squares[move->from-1];
-            board->squares[move->from-1] = EMPTY;
-        }
+static inline void nnue_add_feature(const Network *net, Accumulator *acc, int peice, int square){
+    for(int perspective=0; perspective<2; perspective++){
+        nnue_update(acc->values[perspective], nnue_feature(net, perspective, peice, square), NULL);
     }
+}
 
-    board->to_move = - board->to_move;
+static inline void nnue_sub_feature(const Network *net, Accumulator *acc, int peice, int square){
+    for(int perspective=0; perspective<2; perspective++){
+        nnue_update(acc->values[perspective], NULL, nnue_feature(net, perspective, peice, square));
+    }
+}
 
-    if(board->to_move == -1){
-        board->fullmove_number--;
+static inline void nnue_move_feature(const Network *net, Accumulator *acc, int peice, int from, int to){
+    for(int perspective=0; perspective<2; perspective++){
+        nnue_update(acc->values[perspective], nnue_feature(net, perspective, peice, to), nnue_feature(net, perspective, peice, from));
     }
 }
 
-int evaluate_board(Board *board){
-    int score = 0;
-    for(int i=0; i<64; i++){
-        int peice = board->squares[i];
-        if(peice != EMPTY){
-            int value = PEICE_VALUES[peice%6];
-            if(peice >= W_PAWN && peice <= W_KING){
-                score += value;
-            }
-            else if(peice >= B_PAWN && peice <= B_KING){
-                score -= value;
-            }
-        }
+// Computes the accumulator of board from scratch
+void nnue_refresh(Board *board, Accumulator *acc){
+    for(int perspective=0; perspective<2; perspective++){
+        memcpy(acc->values[perspective], board->net->feature_bias, sizeof(acc->values[perspective]));
+    }
+    for(int sq=0; sq<64; sq++){
+        if(board->squares[sq] != EMPTY) nnue_add_feature(board->net, acc, board->squares[sq], sq);
     }
-    return score * board->to_move;
 }
 
-// Mimimax search with alpha beta pruning and time managment
-int minimax(Board *board, int depth, int alpha, int beta, int maximizingPlayer, clock_t end_time){
-    //Leaf Node of game tree
-    if(depth == 0 || clock() > end_time){
-        return evaluate_board(board);
+// Clipped ReLU of one accumulator half dotted with its output weights
+static inline int nnue_output(const int16_t *values, const int16_t *weights){
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ceiling = _mm256_set1_epi16(NNUE_QA);
+    __m256i sum = _mm256_setzero_si256();
+    for(int i=0; i<NNUE_HIDDEN; i+=16){
+        __m256i v = _mm256_loadu_si256((const __m256i *)(values + i));
+        v = _mm256_min_epi16(_mm256_max_epi16(v, zero), ceiling);
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v, _mm256_loadu_si256((const __m256i *)(weights + i))));
     }
+    __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0x4E));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0xB1));
+    return _mm_cvtsi128_si32(sum128);
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ceiling = _mm_set1_epi16(NNUE_QA);
+    __m128i sum = _mm_setzero_si128();
+    for(int i=0; i<NNUE_HIDDEN; i+=8){
+        __m128i v = _mm_loadu_si128((const __m128i *)(values + i));
+        v = _mm_min_epi16(_mm_max_epi16(v, zero), ceiling);
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(v, _mm_loadu_si128((const __m128i *)(weights + i))));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+#else
+    int sum = 0;
+    for(int i=0; i<NNUE_HIDDEN; i++){
+        int v = values[i] < 0 ? 0 : values[i] > NNUE_QA ? NNUE_QA : values[i];
+        sum += v * weights[i];
+    }
+    return sum;
+#endif
+}
 
-    Move moves[MAX_MOVES];
-    int num_moves = generate_moves(board, moves);
+// Network score of the position attached to board->acc, from the side to move's point of view
+int nnue_evaluate(Board *board){
+    int us = COLOR_INDEX(board->to_move);
+    const Network *net = board->net;
+    int output = net->output_bias
+               + nnue_output(board->acc->values[us], net->output_weights)
+               + nnue_output(board->acc->values[us ^ 1], net->output_weights + NNUE_HIDDEN);
+    return output * NNUE_SCALE / (NNUE_QA * NNUE_QB);
+}
 
-    if(num_moves == 0){
-        //Check mate or stale mate
-        return evaluate_board(board);
+// Makes apply_move/undo_move keep a stack of accumulators for net starting at stack, the first entry is refreshed for board
+void nnue_attach(Board *board, Accumulator *stack, const Network *net){
+    board->net = net;
+    nnue_refresh(board, stack);
+    board->acc = stack;
+}
+
+// --------------------- //
+
+// Rebuilds every derived field of the board from squares[]
+void init_board_state(Board *board){
+    memset(board->peice_bb, 0, sizeof(board->peice_bb));
+    memset(board->color_bb, 0, sizeof(board->color_bb));
+    for(int sq=0; sq<64; sq++){
+        int peice = board->squares[sq];
+        if(peice == EMPTY) continue;
+        board->peice_bb[peice] |= SQUARE_BB(sq);
+        board->color_bb[PEICE_COLOR(peice)] |= SQUARE_BB(sq);
     }
+    board->occupied = board->color_bb[0] | board->color_bb[1];
+
+    board->castling_rights &= 0xF;
+    board->hash = zobrist_castling[board->castling_rights];
+    board->pawn_hash = zobrist_no_pawns;
+    board->psq_mg = board->psq_eg = board->phase = 0;
+    for(int sq=0; sq<64; sq++){
+        int peice = board->squares[sq];
+        if(peice == EMPTY) continue;
+        board->hash ^= zobrist_peice[peice][sq];
+        if(PEICE_TYPE(peice) == W_PAWN) board->pawn_hash ^= zobrist_peice[peice][sq];
+        board->psq_mg += psq_mg[peice][sq];
+        board->psq_eg += psq_eg[peice][sq];
+        board->phase += PHASE_WEIGHTS[PEICE_TYPE(peice)];
+    }
+    if(board->en_passant >= 0) board->hash ^= zobrist_en_passant[board->en_passant % 8];
+    if(board->to_move == -1) board->hash ^= zobrist_side;
+    board->acc = NULL; // Attached by the search with nnue_attach()
 
-    sort_moves(board, moves, num_moves);
+    uint64_t king = board->peice_bb[(board->to_move == 1) ? W_KING : B_KING];
+    board->checkers = king ? attackers_to(board, lsb(king), board->occupied) & board->color_bb[COLOR_INDEX(-board->to_move)] : 0;
+}
 
-    if(maximizingPlayer){
-        int maxEval = -INFINITY;
-        for(int i=0; i<num_moves; i++){
-            apply_move(board, &moves[i]);
-            int eval = minimax(board, depth -1, alpha, beta, 0, end_time);
-            undo_move(board, &moves[i]);
+static inline void put_peice(Board *board, int peice, int square){
+    uint64_t bb = SQUARE_BB(square);
+    board->squares[square] = peice;
+    board->peice_bb[peice] |= bb;
+    board->color_bb[PEICE_COLOR(peice)] |= bb;
+    board->occupied |= bb;
+    board->hash ^= zobrist_peice[peice][square];
+    if(PEICE_TYPE(peice) == W_PAWN) board->pawn_hash ^= zobrist_peice[peice][square];
+    board->psq_mg += psq_mg[peice][square];
+    board->psq_eg += psq_eg[peice][square];
+    board->phase += PHASE_WEIGHTS[PEICE_TYPE(peice)];
+    if(board->acc) nnue_add_feature(board->net, board->acc, peice, square);
+}
 
-            if(eval > maxEval){
-                maxEval = eval;
-            }
+static inline void remove_peice(Board *board, int square){
+    uint64_t bb = SQUARE_BB(square);
+    int peice = board->squares[square];
+    board->squares[square] = EMPTY;
+    board->peice_bb[peice] &= ~bb;
+    board->color_bb[PEICE_COLOR(peice)] &= ~bb;
+    board->occupied &= ~bb;
+    board->hash ^= zobrist_peice[peice][square];
+    if(PEICE_TYPE(peice) == W_PAWN) board->pawn_hash ^= zobrist_peice[peice][square];
+    board->psq_mg -= psq_mg[peice][square];
+    board->psq_eg -= psq_eg[peice][square];
+    board->phase -= PHASE_WEIGHTS[PEICE_TYPE(peice)];
+    if(board->acc) nnue_sub_feature(board->net, board->acc, peice, square);
+}
 
-            if(eval > alpha){
-                alpha = eval;
-            }
+static inline void move_peice(Board *board, int from, int to){
+    uint64_t from_to = SQUARE_BB(from) | SQUARE_BB(to);
+    int peice = board->squares[from];
+    board->squares[from] = EMPTY;
+    board->squares[to] = peice;
+    board->peice_bb[peice] ^= from_to;
+    board->color_bb[PEICE_COLOR(peice)] ^= from_to;
+    board->occupied ^= from_to;
+    board->hash ^= zobrist_peice[peice][from] ^ zobrist_peice[peice][to];
+    if(PEICE_TYPE(peice) == W_PAWN) board->pawn_hash ^= zobrist_peice[peice][from] ^ zobrist_peice[peice][to];
+    board->psq_mg += psq_mg[peice][to] - psq_mg[peice][from];
+    board->psq_eg += psq_eg[peice][to] - psq_eg[peice][from];
+    if(board->acc) nnue_move_feature(board->net, board->acc, peice, from, to);
+}
 
-            if(beta <= alpha){
-                break; // Beta Cutoff
-            }
+// --------------------- //
 
-            if(clock() > end_time){
-                break;
-            }
-        }
-        return maxEval;
-    }
-    else{
-        int minEval = INFINITY;
-        for(int i=0; i<num_moves; i++){
-            apply_move(board, &moves[i]);
-            int eval = minimax(board, depth -1, alpha, beta, 1, end_time);
-            undo_move(board, &moves[i]);
+// ------- Endgame Bitbases ---------- //
+// Win or draw for every position of king and queen, rook, pawn or bishop and knight against a bare king, found by
+// retrograde analysis. The side with the material is made white. For each placement of the white king and peices
+// (a configuration) one 64 bit word per side to move holds a bit for each square of the black king: set if white
+// wins, clear for a draw or an illegal position. The bare king can never win, so nothing else needs storing
 
-            if(eval < minEval){
-                minEval = eval;
-            }
-            
-            if(eval < beta){
-                beta = eval;
-            }
+#define KNOWN_WIN 10000 // Won bitbase positions score this plus material and progress, far from any mate score
+#define BITBASE_MAGIC "CBB1"
 
-            if(beta <= alpha){
-                break; // Alpha cutoff
-            }
+enum BitbaseKind { BITBASE_KQK, BITBASE_KRK, BITBASE_KPK, BITBASE_KBNK, NUM_BITBASES };
 
-            if(clock() > end_time){
-                break;
-            }
+typedef struct {
+    int peices[2]; // White peices besides the king, in configuration order
+    int num_peices;
+    uint64_t num_configs; // 64 ^ (1 + num_peices), the configuration is wk + 64 * peices[0] + 4096 * peices[1]
+    uint64_t *win[2]; // [0] white to move, [1] black to move
+} Bitbase;
+
+// Built in dependency order, KPK promotes into KQK and KRK
+Bitbase bitbases[NUM_BITBASES] = {
+    {{W_QUEEN, EMPTY}, 1, 64 * 64, {NULL, NULL}},
+    {{W_ROOK, EMPTY}, 1, 64 * 64, {NULL, NULL}},
+    {{W_PAWN, EMPTY}, 1, 64 * 64, {NULL, NULL}},
+    {{W_BISHOP, W_KNIGHT}, 2, 64 * 64 * 64, {NULL, NULL}},
+};
+
+bool bitbases_ready = false;
+uint64_t *bitbase_memory = NULL; // Generated in this process, or
+void *bitbase_mapping = NULL; // mapped from a cache file
+size_t bitbase_mapping_size = 0;
+std::mutex bitbase_lock;
+
+static inline uint64_t bitbase_words(){
+    uint64_t words = 0;
+    for(int kind=0; kind<NUM_BITBASES; kind++) words += 2 * bitbases[kind].num_configs;
+    return words;
+}
+
+// Points the tables into words, laid out one after the other as in the cache file
+static void bitbase_assign(uint64_t *words){
+    for(int kind=0; kind<NUM_BITBASES; kind++){
+        for(int side=0; side<2; side++){
+            bitbases[kind].win[side] = words;
+            words += bitbases[kind].num_configs;
         }
-        return minEval;
     }
 }
 
-// Heuristice for Move Ordering
-int move_heuristic(Board *board, Move *move){
-    int score = 0;
+// Moves every square of bb one step in direction 0-7 (N, NE, E, SE, S, SW, W, NW), dropping what leaves the board
+static inline uint64_t shift_bb(uint64_t bb, int direction){
+    switch(direction){
+        case 0: return bb << 8;
+        case 1: return (bb << 9) & ~FILE_A;
+        case 2: return (bb << 1) & ~FILE_A;
+        case 3: return (bb >> 7) & ~FILE_A;
+        case 4: return bb >> 8;
+        case 5: return (bb >> 9) & ~FILE_H;
+        case 6: return (bb >> 1) & ~FILE_H;
+        default: return (bb << 7) & ~FILE_H;
+    }
+}
 
-    //Prioritize most the king moves if king is check
+// Squares of a configuration, false if two share a square or a pawn stands on the first or last rank
+static bool bitbase_config(const Bitbase *bb, uint64_t config, int *squares){
+    uint64_t occupied = 0;
+    for(int i=0; i<=bb->num_peices; i++){
+        squares[i] = (int)(config >> (6 * i)) & 63;
+        if(occupied & SQUARE_BB(squares[i])) return false;
+        occupied |= SQUARE_BB(squares[i]);
+        if(i > 0 && bb->peices[i - 1] == W_PAWN && (squares[i] < 8 || squares[i] >= 56)) return false;
+    }
+    return true;
+}
 
+// Squares attacked by white, black king aside: it blocks nothing that matters, as it cannot stand on a line it is checked along
+static uint64_t bitbase_attacks(const Bitbase *bb, const int *squares, uint64_t occupied){
+    uint64_t attacks = king_attacks[squares[0]];
+    for(int i=0; i<bb->num_peices; i++){
+        int sq = squares[i + 1];
+        switch(bb->peices[i]){
+            case W_PAWN: attacks |= pawn_attacks[0][sq]; break;
+            case W_KNIGHT: attacks |= knight_attacks[sq]; break;
+            case W_BISHOP: attacks |= bishop_attacks(sq, occupied); break;
+            case W_ROOK: attacks |= rook_attacks(sq, occupied); break;
+            default: attacks |= queen_attacks(sq, occupied); break;
+        }
+    }
+    return attacks;
+}
 
+// White to move: won where some move reaches a won black to move position. Each move is masked with the
+// black king squares it is legal for: not adjacent to the moved king, not on the target square or in the way
+static uint64_t bitbase_white_step(const Bitbase *bb, uint64_t config){
+    int squares[3];
+    if(!bitbase_config(bb, config, squares)) return 0;
+    uint64_t occupied = 0;
+    for(int i=0; i<=bb->num_peices; i++) occupied |= SQUARE_BB(squares[i]);
+    uint64_t *next = bb->win[1];
+    uint64_t won = 0;
+
+    uint64_t targets = king_attacks[squares[0]] & ~occupied;
+    while(targets){
+        int to = pop_lsb(&targets);
+        won |= next[(config & ~63ULL) | to] & ~king_attacks[to] & ~SQUARE_BB(to);
+    }
 
-    //Prioritize Captures
-    if(move->captured != EMPTY){
-        score += 10 * (PEICE_VALUES[move->captured%6] - PEICE_VALUES[move->peice%6]);
+    for(int i=0; i<bb->num_peices; i++){
+        int from = squares[i + 1], shift = 6 * (i + 1);
+        uint64_t base = config & ~(63ULL << shift);
+        if(bb->peices[i] == W_PAWN){
+            int to = from + 8;
+            if(occupied & SQUARE_BB(to)) continue;
+            if(to >= 56){
+                // Queen, or rook for the positions where the queen stalemates
+                uint64_t promoted = (config & 63) | ((uint64_t)to << 6);
+                won |= (bitbases[BITBASE_KQK].win[1][promoted] | bitbases[BITBASE_KRK].win[1][promoted]) & ~SQUARE_BB(to);
+                continue;
+            }
+            won |= next[base | ((uint64_t)to << shift)] & ~SQUARE_BB(to);
+            if(from < 16 && !(occupied & SQUARE_BB(to + 8))){
+                won |= next[base | ((uint64_t)(to + 8) << shift)] & ~SQUARE_BB(to) & ~SQUARE_BB(to + 8);
+            }
+            continue;
+        }
+        switch(bb->peices[i]){
+            case W_KNIGHT: targets = knight_attacks[from] & ~occupied; break;
+            case W_BISHOP: targets = bishop_attacks(from, occupied) & ~occupied; break;
+            case W_ROOK: targets = rook_attacks(from, occupied) & ~occupied; break;
+            default: targets = queen_attacks(from, occupied) & ~occupied; break;
+        }
+        while(targets){
+            int to = pop_lsb(&targets);
+            won |= next[base | ((uint64_t)to << shift)] & ~SQUARE_BB(to) & ~between_bb[from][to];
+        }
     }
+    // Black may not be in check with white to move
+    return won & ~bitbase_attacks(bb, squares, occupied) & ~occupied;
+}
 
-    //Prioritize Promotions
-    if(move->promotion != EMPTY){
-        score += PEICE_VALUES[move->promotion%6];
+// Black to move: won where black has no legal move other than into won positions, or is mated. Taking an
+// undefended peice draws (K vs K, or a lone minor peice)
+static uint64_t bitbase_black_step(const Bitbase *bb, uint64_t config){
+    int squares[3];
+    if(!bitbase_config(bb, config, squares)) return 0;
+    uint64_t occupied = 0;
+    for(int i=0; i<=bb->num_peices; i++) occupied |= SQUARE_BB(squares[i]);
+    uint64_t attacked = bitbase_attacks(bb, squares, occupied);
+    uint64_t legal = ~attacked; // Destinations
+    uint64_t good = legal & ~occupied & bb->win[0][config];
+
+    uint64_t can_move = 0, can_escape = 0; // Black king squares with some legal move, some move to a draw
+    for(int direction=0; direction<8; direction++){
+        can_move |= shift_bb(legal, direction);
+        can_escape |= shift_bb(legal & ~good, direction);
     }
-    // Prioritize Checks [Not Implemented]
-    // Prioritize Threats [Not Implemented]
-    return score;
+    uint64_t won = ~can_escape & (can_move | attacked);
+    return won & ~occupied & ~king_attacks[squares[0]];
 }
 
-// Sort Moves based on Move Heuristic
-void sort_moves(Board *board, Move *moves, int num_moves){
-    // Insertion sort based on key score
-    for(int i= 1; i<num_moves; i++){
-        Move key = moves[i];
-        int key_score = move_heuristic(board, &key);
-        int j = i-1;
-        while(j>=0 && move_heuristic (board, &moves[j]) < key_score){
-            moves[j+1] = moves[j];
-            j = j-1;
+// Runs step over the configurations [first, last) of bb into table, setting changed if a word grew
+static void bitbase_pass(Bitbase *bb, int side, uint64_t first, uint64_t last, std::atomic<bool> *changed){
+    bool grew = false;
+    for(uint64_t config=first; config<last; config++){
+        uint64_t won = side == 0 ? bitbase_white_step(bb, config) : bitbase_black_step(bb, config);
+        if(won != bb->win[side][config]){
+            bb->win[side][config] = won;
+            grew = true;
         }
-        moves[j+1] = key;
     }
+    if(grew) changed->store(true, std::memory_order_relaxed);
 }
 
-// Choosing the Best Move within the time constraints
-const char *choose_best_move(Board *board, double per_move_time, double total_time){
-    clock_t start_time = clock();
-    clock_t end_time = start_time + (clock_t)(per_move_time * CLOCKS_PER_SEC);
+// Iterates from nothing won until neither side gains a position. A white pass only reads the black table
+// and a black pass only its own configuration of the white table, so configurations can be split across threads
+static void bitbase_generate(Bitbase *bb, int threads){
+    std::atomic<bool> changed;
+    std::thread *workers = new std::thread[threads];
+    do{
+        changed = false;
+        for(int side=0; side<2; side++){
+            for(int t=0; t<threads; t++){
+                workers[t] = std::thread(bitbase_pass, bb, side, bb->num_configs * t / threads, bb->num_configs * (t + 1) / threads, &changed);
+            }
+            for(int t=0; t<threads; t++) workers[t].join();
+        }
+    } while(changed);
+    delete[] workers;
+}
 
-    Move moves[MAX_MOVES];
-    int num_moves = generate_moves(board, moves);
+// Maps the cache file if it holds bitbases, returns 0 if it does not
+static int bitbase_map(const char *path){
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return 0;
+    struct stat st;
+    size_t expected = 8 + bitbase_words() * sizeof(uint64_t);
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size != expected){
+        close(fd);
+        return 0;
+    }
+    void *mapping = mmap(NULL, expected, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED) return 0;
+    if(memcmp(mapping, BITBASE_MAGIC, 4) != 0){
+        munmap(mapping, expected);
+        return 0;
+    }
+    bitbase_mapping = mapping;
+    bitbase_mapping_size = expected;
+    bitbase_assign((uint64_t *)((char *)mapping + 8));
+    return 1;
+}
 
-    if(num_moves == 0){
-        return NULL; // No Legal Moves
+// Writes the generated tables, through a temporary file so a reader never maps half of one
+static int bitbase_save(const char *path){
+    char temporary[4096];
+    snprintf(temporary, sizeof(temporary), "%s.%d.tmp", path, (int)getpid());
+    FILE *file = fopen(temporary, "wb");
+    if(file == NULL) return 0;
+    char header[8] = BITBASE_MAGIC;
+    uint64_t words = bitbase_words();
+    bool ok = fwrite(header, 1, 8, file) == 8 && fwrite(bitbase_memory, sizeof(uint64_t), words, file) == words;
+    ok = fclose(file) == 0 && ok;
+    if(!ok || rename(temporary, path) != 0){
+        remove(temporary);
+        return 0;
     }
+    return 1;
+}
 
-    Move best_move = moves[0];
-    int best_score = -INFINITY;
+// Makes the bitbases available to every engine: maps path if it holds them, otherwise builds them on every core
+// (about 4 MB, a second or so) and saves them to path for the next process. path may be NULL to only build them.
+// Nothing builds them behind the caller's back, so call this at startup, outside any search's time budget.
+// Once loaded they stay, later calls only write the cache. Returns 0 if path was given but could be neither read nor written
+int load_bitbases(const char *path){
+    std::lock_guard<std::mutex> guard(bitbase_lock);
+    if(!bitbases_ready && path && bitbase_map(path)){
+        bitbases_ready = true;
+        return 1;
+    }
+    if(!bitbases_ready){
+        bitbase_memory = (uint64_t *)calloc(bitbase_words(), sizeof(uint64_t));
+        bitbase_assign(bitbase_memory);
+        int threads = (int)std::thread::hardware_concurrency();
+        for(int kind=0; kind<NUM_BITBASES; kind++) bitbase_generate(&bitbases[kind], threads > 0 ? threads : 1);
+        bitbases_ready = true;
+    }
+    if(path == NULL || bitbase_memory == NULL) return 1;
+    return bitbase_save(path);
+}
 
-    int depth = 1;
-    while(depth <= MAX_DEPTH){
-        if(clock() > end_time){
-            break;
-        }
+static inline int square_distance(int a, int b){
+    int files = abs(a % 8 - b % 8), ranks = abs(a / 8 - b / 8);
+    return files > ranks ? files : ranks;
+}
 
-        for(int i=0; i<num_moves; i++){
-            apply_move(board, &moves[i]);
-            int score = minimax(board, depth-1, -INFINITY, INFINITY, 0,  end_time);
-            undo_move(board, &moves[i]);
+// Exact score of an endgame covered by the bitbases, from the side to move's view. Draws score 0. Wins score
+// KNOWN_WIN plus terms that lead the search towards the mate (or promotion) it cannot see yet: the bare king
+// driven to the edge (KBNK: a corner the bishop covers) and the kings close together, or the pawn advanced.
+// Returns false for any other position
+bool bitbase_evaluate(const Board *board, int *score){
+    if(!bitbases_ready || popcount(board->occupied) > 4 || board->castling_rights) return false;
+    int strong = popcount(board->color_bb[0]) > 1 ? 0 : 1;
+    if(popcount(board->color_bb[strong ^ 1]) != 1) return false;
+
+    // Seen from the strong side, mirrored top to bottom when that is black
+    int flip = strong ? 56 : 0, offset = strong ? B_PAWN - W_PAWN : 0;
+    int kind;
+    uint64_t peices = board->color_bb[strong] & ~board->peice_bb[W_KING + offset];
+    if(popcount(peices) == 1){
+        int type = PEICE_TYPE(board->squares[lsb(peices)]);
+        if(type == W_QUEEN) kind = BITBASE_KQK;
+        else if(type == W_ROOK) kind = BITBASE_KRK;
+        else if(type == W_PAWN) kind = BITBASE_KPK;
+        else return false;
+    }
+    else if(board->peice_bb[W_BISHOP + offset] && board->peice_bb[W_KNIGHT + offset]){
+        kind = BITBASE_KBNK;
+    }
+    else{
+        return false;
+    }
 
-            if(score > best_score){
-                best_score = score;
-                best_move = moves[i];
-            }
+    const Bitbase *bb = &bitbases[kind];
+    int white_king = lsb(board->peice_bb[W_KING + offset]) ^ flip;
+    int black_king = lsb(board->peice_bb[B_KING - offset]) ^ flip;
+    uint64_t config = white_king;
+    for(int i=0; i<bb->num_peices; i++){
+        config |= (uint64_t)(lsb(board->peice_bb[bb->peices[i] + offset]) ^ flip) << (6 * (i + 1));
+    }
+    int strong_to_move = COLOR_INDEX(board->to_move) == strong;
+    if(!((bb->win[strong_to_move ? 0 : 1][config] >> black_king) & 1)){
+        *score = 0;
+        return true;
+    }
 
-            if(clock() > end_time){
-                break;
+    int value = KNOWN_WIN + 10 * (7 - square_distance(white_king, black_king));
+    if(kind == BITBASE_KPK){
+        value += PEICE_VALUES[W_PAWN] + 20 * ((int)(config >> 6) / 8);
+    }
+    else{
+        for(int i=0; i<bb->num_peices; i++) value += PEICE_VALUES[bb->peices[i]];
+        int corner = 0; // Distance to the edge, or for KBNK to the nearer corner of the bishop's colour
+        if(kind == BITBASE_KBNK){
+            int bishop = (int)(config >> 6) & 63;
+            int first = ((bishop / 8 + bishop % 8) & 1) ? 7 : 0; // h1/a8 for light squares, a1/h8 for dark
+            int near = square_distance(black_king, first), far = square_distance(black_king, 63 - first);
+            corner = 7 - (near < far ? near : far);
+        }
+        else{
+            corner = 3;
+            for(int centre : {27, 28, 35, 36}){
+                if(square_distance(black_king, centre) < corner) corner = square_distance(black_king, centre);
             }
         }
-        depth++;
+        value += 20 * corner;
     }
+    *score = strong_to_move ? value : -value;
+    return true;
+}
 
-    // Converting best move into right UCI notation
-    notation_buffer[0] = 'a' + (best_move.from%8);
-    notation_buffer[1] = '1' + (best_move.from/8);
-    notation_buffer[2] = 'a' + (best_move.to%8);
-    notation_buffer[3] = '1' + (best_move.to/8);
-    notation_buffer[4] = '\0';
+// --------------------- //
 
-    //Added promtion
-    if(best_move.promotion != EMPTY){
-        char promotion_value;
-        switch(best_move.promotion){
-            case W_KNIGHT:
-            case B_KNIGHT:
-                promotion_value = 'n';
-                break;
-            case W_BISHOP:
-            case B_BISHOP:
-                promotion_value = 'b';
-                break;
-            case W_ROOK:
-            case B_ROOK:
-                promotion_value = 'r';
-                break;
-            default:
-                promotion_value = 'q';
-        }
-        notation_buffer[4] = promotion_value;
-        notation_buffer[5] = '\0';
-    }
-    return notation_buffer;
+// ------- Attack Queries ---------- //
+// These look outward from the target square instead of generating the attacker's moves
+
+// Every peice of either colour attacking square, with the given occupancy for slider rays
+uint64_t attackers_to(Board *board, int square, uint64_t occupied){
+    return (pawn_attacks[1][square] & board->peice_bb[W_PAWN])
+         | (pawn_attacks[0][square] & board->peice_bb[B_PAWN])
+         | (knight_attacks[square] & (board->peice_bb[W_KNIGHT] | board->peice_bb[B_KNIGHT]))
+         | (king_attacks[square] & (board->peice_bb[W_KING] | board->peice_bb[B_KING]))
+         | (bishop_attacks(square, occupied) & (board->peice_bb[W_BISHOP] | board->peice_bb[B_BISHOP] | board->peice_bb[W_QUEEN] | board->peice_bb[B_QUEEN]))
+         | (rook_attacks(square, occupied) & (board->peice_bb[W_ROOK] | board->peice_bb[B_ROOK] | board->peice_bb[W_QUEEN] | board->peice_bb[B_QUEEN]));
+}
+
+// True if square is attacked by the opponent of side (side is 1 for white, -1 for black)
+bool is_square_attacked(Board *board, int square, int side){
+    int us = COLOR_INDEX(side);
+    int enemy = (side == 1) ? B_PAWN : W_PAWN; // Pawn of the attacking side, other peices follow in enum order
+    uint64_t queens = board->peice_bb[enemy + 4];
+    return (pawn_attacks[us][square] & board->peice_bb[enemy])
+        || (knight_attacks[square] & board->peice_bb[enemy + 1])
+        || (king_attacks[square] & board->peice_bb[enemy + 5])
+        || (bishop_attacks(square, board->occupied) & (board->peice_bb[enemy + 2] | queens))
+        || (rook_attacks(square, board->occupied) & (board->peice_bb[enemy + 3] | queens));
+}
+
+// True if the king of side is attacked
+bool in_check(Board *board, int side){
+    uint64_t king = board->peice_bb[(side == 1) ? W_KING : B_KING];
+    return king && is_square_attacked(board, lsb(king), side);
 }
 
+// Adds a pawn move, expanding it into the four promotions on the last rank
+static inline int add_pawn_move(Move *moves, int num_moves, int from, int to){
+    if(to >= 56 || to < 8){
+        for(int promotion = W_QUEEN; promotion > W_PAWN; promotion--){ // Queen, Rook, Bishop, Knight
+            moves[num_moves++] = make_promotion(from, to, promotion);
+        }
+    }
+    else{
+        moves[num_moves++] = make_move(from, to, MOVE_NORMAL);
+    }
+    return num_moves;
+}
+
+// Own peices that are the only blocker between our king and an enemy slider
+static uint64_t pinned_peices(Board *board, int us, int king_square){
+    int enemy = (us == 0) ? B_PAWN : W_PAWN;
+    uint64_t queens = board->peice_bb[enemy + 4];
+    uint64_t snipers = (rook_attacks(king_square, 0) & (board->peice_bb[enemy + 3] | queens))
+                     | (bishop_attacks(king_square, 0) & (board->peice_bb[enemy + 2] | queens));
+    uint64_t pinned = 0;
+    while(snipers){
+        uint64_t blockers = between_bb[king_square][pop_lsb(&snipers)] & board->occupied;
+        if(blockers && !(blockers & (blockers - 1))){
+            pinned |= blockers & board->color_bb[us];
+        }
+    }
+    return pinned;
+}
+
+// Castling, the king may not start on, pass through or land on an attacked square
+static bool can_castle(Board *board, int kingside){
+    int side = board->to_move;
+    int king = (side == 1) ? W_KING : B_KING;
+    int king_square = (side == 1) ? 4 : 60;
+    int step = kingside ? 1 : -1;
+    int right = kingside ? (side == 1 ? 0x1 : 0x4) : (side == 1 ? 0x2 : 0x8);
+
+    if(!(board->castling_rights & right) || board->checkers || board->squares[king_square] != king) return false;
+    if(board->squares[king_square + (kingside ? 3 : -4)] != king - 2) return false; // Rook on its home square
+    if(board->squares[king_square + step] != EMPTY || board->squares[king_square + 2 * step] != EMPTY) return false;
+    if(!kingside && board->squares[king_square - 3] != EMPTY) return false;
+    return !is_square_attacked(board, king_square + step, side) && !is_square_attacked(board, king_square + 2 * step, side);
+}
+
+// Generate all legal moves of the given type for current board position
+// In check only evasions are produced, and pinned peices only move along their pin ray
+// GEN_CAPTURES holds captures and every promotion, GEN_QUIETS everything else
+int generate_moves(Board *board, Move *moves, int type){
+    int num_moves = 0;
+    int side = board->to_move;
+    int us = COLOR_INDEX(side);
+    int base = (side == 1) ? W_PAWN : B_PAWN; // Pawn of the side to move, other peices follow in enum order
+    uint64_t own = board->color_bb[us];
+    uint64_t enemy = board->color_bb[us ^ 1];
+    uint64_t empty = ~board->occupied;
+    int king_square = lsb(board->peice_bb[base + 5]);
+    uint64_t checkers = board->checkers;
+    uint64_t type_mask = (type == GEN_CAPTURES) ? enemy : (type == GEN_QUIETS) ? empty : ~own;
+    uint64_t promotion_rank = (side == 1) ? RANK_8 : RANK_1;
+
+    // King Moves, with the king lifted off the board so it cannot shelter behind itself on a slider ray
+    {
+        uint64_t targets = king_attacks[king_square] & type_mask;
+        uint64_t occupied = board->occupied ^ SQUARE_BB(king_square);
+        while(targets){
+            int to = pop_lsb(&targets);
+            if(!(attackers_to(board, to, occupied) & enemy)){
+                moves[num_moves++] = make_move(king_square, to, MOVE_NORMAL);
+            }
+        }
+    }
+
+    // Double check, only the king can move
+    if(checkers & (checkers - 1)){
+        return num_moves;
+    }
+
+    // Squares that resolve a single check: capturing the checker or blocking its ray
+    uint64_t check_mask = checkers ? (between_bb[king_square][lsb(checkers)] | checkers) : ~0ULL;
+    uint64_t pinned = pinned_peices(board, us, king_square);
+
+    // Pawn Moves
+    {
+        uint64_t pawns = board->peice_bb[base];
+        int up = (side == 1) ? 8 : -8;
+
+        // Move Type-1 (Forward Moves)
+        uint64_t single = (side == 1) ? (pawns << 8) & empty : (pawns >> 8) & empty;
+        uint64_t double_push = (side == 1) ? ((single & RANK_3) << 8) & empty : ((single & RANK_6) >> 8) & empty;
+        single &= check_mask & (type == GEN_CAPTURES ? promotion_rank : type == GEN_QUIETS ? ~promotion_rank : ~0ULL);
+        double_push &= (type == GEN_CAPTURES) ? 0 : check_mask;
+        if(type == GEN_QUIETS) pawns = 0; // Captures and en passant below are not quiet
+        while(single){
+            int to = pop_lsb(&single);
+            if(!(pinned & SQUARE_BB(to - up)) || (line_bb[king_square][to - up] & SQUARE_BB(to))){
+                num_moves = add_pawn_move(moves, num_moves, to - up, to);
+            }
+        }
+        while(double_push){
+            int to = pop_lsb(&double_push);
+            if(!(pinned & SQUARE_BB(to - 2 * up)) || (line_bb[king_square][to - 2 * up] & SQUARE_BB(to))){
+                moves[num_moves++] = make_move(to - 2 * up, to, MOVE_NORMAL);
+            }
+        }
+
+        // Move Type-2 (Captures + En Passant)
+        while(pawns){
+            int from = pop_lsb(&pawns);
+            uint64_t targets = pawn_attacks[us][from] & enemy & check_mask;
+            if(pinned & SQUARE_BB(from)) targets &= line_bb[king_square][from];
+            while(targets){
+                num_moves = add_pawn_move(moves, num_moves, from, pop_lsb(&targets));
+            }
+
+            // Two pawns leave the rank at once, so the result is tested directly on the changed occupancy
+            if(board->en_passant >= 0 && (pawn_attacks[us][from] & SQUARE_BB(board->en_passant))){
+                int captured_square = board->en_passant - up;
+                uint64_t occupied = (board->occupied ^ SQUARE_BB(from) ^ SQUARE_BB(captured_square)) | SQUARE_BB(board->en_passant);
+                if(!(attackers_to(board, king_square, occupied) & enemy & ~SQUARE_BB(captured_square))){
+                    moves[num_moves++] = make_move(from, board->en_passant, MOVE_EN_PASSANT);
+                }
+            }
+        }
+    }
+
+    // Knight, Bishop, Rook and Queen Moves
+    for(int peice = base + 1; peice <= base + 4; peice++){
+        uint64_t peices = board->peice_bb[peice];
+        while(peices){
+            int from = pop_lsb(&peices);
+            uint64_t targets;
+            switch(peice - base){
+                case 1: targets = knight_attacks[from]; break;
+                case 2: targets = bishop_attacks(from, board->occupied); break;
+                case 3: targets = rook_attacks(from, board->occupied); break;
+                default: targets = queen_attacks(from, board->occupied); break;
+            }
+            targets &= type_mask & check_mask;
+            if(pinned & SQUARE_BB(from)) targets &= line_bb[king_square][from];
+            while(targets){
+                int to = pop_lsb(&targets);
+                moves[num_moves++] = make_move(from, to, MOVE_NORMAL);
+            }
+        }
+    }
+
+    if(type != GEN_CAPTURES){
+        // Kingside Castling
+        if(can_castle(board, 1)){
+            moves[num_moves++] = make_move(king_square, king_square + 2, MOVE_CASTLING);
+        }
+
+        // Queenside Castling
+        if(can_castle(board, 0)){
+            moves[num_moves++] = make_move(king_square, king_square - 2, MOVE_CASTLING);
+        }
+    }
+    return num_moves;
+}
+
+// Castling rights that survive a move touching each square
+static const int CASTLING_MASK[64] = {
+    ~0x2 & 0xF, 0xF, 0xF, 0xF, ~0x3 & 0xF, 0xF, 0xF, ~0x1 & 0xF,
+    0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF,
+    0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF,
+    0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF,
+    0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF,
+    0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF,
+    0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF, 0xF,
+    ~0x8 & 0xF, 0xF, 0xF, 0xF, ~0xC & 0xF, 0xF, 0xF, ~0x4 & 0xF,
+};
+
+// Plays move, saving what undo_move needs in state
+void apply_move(Board *board, Move move, StateInfo *state){
+    int from = move_from(move), to = move_to(move), kind = move_kind(move);
+    int peice = board->squares[from];
+    int captured = captured_peice(board, move);
+
+    //Save Previous State
+    state->en_passant = board->en_passant;
+    state->castling_rights = board->castling_rights;
+    state->halfmove_clock = board->halfmove_clock;
+    state->hash = board->hash;
+    state->checkers = board->checkers;
+    state->captured = captured;
+
+    // The child gets a copy of the parent accumulator that the peice updates below change
+    if(board->acc){
+        board->acc[1] = board->acc[0];
+        board->acc++;
+    }
+
+    if(board->en_passant >= 0) board->hash ^= zobrist_en_passant[board->en_passant % 8];
+    board->en_passant = -1;
+
+    //Handle Captures (the en passant pawn is not on the target square)
+    if(kind == MOVE_EN_PASSANT){
+        remove_peice(board, to + ((board->to_move == 1) ? -8 : 8));
+    }
+    else if(captured != EMPTY){
+        remove_peice(board, to);
+    }
+
+    //Move the Peice
+    move_peice(board, from, to);
+
+    //Handle double pawn move (set en passant target)
+    if(PEICE_TYPE(peice) == W_PAWN && abs(from - to) == 16){
+        board->en_passant = (from + to) / 2;
+        board->hash ^= zobrist_en_passant[board->en_passant % 8];
+    }
+
+    //Handling Pawn promotions, the new peice has the colour of the pawn
+    if(kind == MOVE_PROMOTION){
+        remove_peice(board, to);
+        put_peice(board, peice - W_PAWN + promotion_type(move), to);
+    }
+
+    // Handle Castling_rights, moving the king or a rook or capturing a rook on its home square
+    board->hash ^= zobrist_castling[board->castling_rights];
+    board->castling_rights &= CASTLING_MASK[from] & CASTLING_MASK[to];
+    board->hash ^= zobrist_castling[board->castling_rights];
+
+    //Handle Castling Move
+    if(kind == MOVE_CASTLING){
+        if(to == from + 2){
+            //Kingside castling
+            move_peice(board, from + 3, from + 1);
+        }
+        else{
+            move_peice(board, from - 4, from - 1);
+        }
+    }
+
+    //Update Turn
+    board->to_move = - board->to_move;
+    board->hash ^= zobrist_side;
+
+    //Update Halfmove Clock
+    if(PEICE_TYPE(peice) == W_PAWN || captured != EMPTY){
+        board->halfmove_clock = 0;
+    }
+    else{
+        board->halfmove_clock++;
+    }
+
+    if(board->to_move == 1){
+        board->fullmove_number++;
+    }
+
+    board->checkers = attackers_to(board, lsb(board->peice_bb[(board->to_move == 1) ? W_KING : B_KING]), board->occupied)
+                    & board->color_bb[COLOR_INDEX(-board->to_move)];
+}
+
+// Takes back move, state is the one apply_move filled in
+void undo_move(Board *board, Move move, const StateInfo *state){
+    int from = move_from(move), to = move_to(move), kind = move_kind(move);
+
+    // The parent accumulator is still one entry down the stack, so the peice updates are skipped
+    Accumulator *acc = board->acc;
+    board->acc = NULL;
+
+    board->en_passant = state->en_passant;
+    board->castling_rights = state->castling_rights;
+    board->halfmove_clock = state->halfmove_clock;
+
+    //Reset Castling Move
+    if(kind == MOVE_CASTLING){
+        if(to == from + 2){
+            //Kingside castling
+            move_peice(board, from + 1, from + 3);
+        }
+        else{
+            move_peice(board, from - 1, from - 4);
+        }
+    }
+
+    // The promoted peice turns back into a pawn of its colour
+    if(kind == MOVE_PROMOTION){
+        int promoted = board->squares[to];
+        remove_peice(board, to);
+        put_peice(board, promoted - promotion_type(move) + W_PAWN, to);
+    }
+
+    move_peice(board, to, from);
+
+    // Rest is en_passant capture
+    if(kind == MOVE_EN_PASSANT){
+        int captures_pawn_pos = to + ((board->to_move == 1) ? 8 : -8);
+        put_peice(board, state->captured, captures_pawn_pos);
+    }
+    else if(state->captured != EMPTY){
+        put_peice(board, state->captured, to);
+    }
+
+    board->to_move = - board->to_move;
+    board->hash = state->hash;
+    board->checkers = state->checkers;
+    board->acc = acc ? acc - 1 : NULL;
+
+    if(board->to_move == -1){
+        board->fullmove_number--;
+    }
+}
+
+// Passes the turn, only legal when not in check
+void apply_null_move(Board *board, StateInfo *state){
+    state->en_passant = board->en_passant;
+    state->hash = board->hash;
+    state->checkers = board->checkers;
+
+    if(board->en_passant >= 0) board->hash ^= zobrist_en_passant[board->en_passant % 8];
+    board->en_passant = -1;
+    board->to_move = -board->to_move;
+    board->hash ^= zobrist_side;
+    board->checkers = 0;
+}
+
+void undo_null_move(Board *board, const StateInfo *state){
+    board->en_passant = state->en_passant;
+    board->hash = state->hash;
+    board->checkers = state->checkers;
+    board->to_move = -board->to_move;
+}
+
+// True if the side to move has a peice other than pawns and king, null moves are unsafe in pawn endings (zugzwang)
+static inline bool has_non_pawn_material(Board *board){
+    int base = (board->to_move == 1) ? W_PAWN : B_PAWN;
+    return (board->peice_bb[base + 1] | board->peice_bb[base + 2] | board->peice_bb[base + 3] | board->peice_bb[base + 4]) != 0;
+}
+
+// Tapered evaluation: the middlegame and endgame scores kept by apply_move/undo_move plus the pawn terms,
+// blended by the game phase. pawn_table may be NULL, the pawn terms are then computed every time.
+// The network is used instead when one is loaded and the search attached accumulators to the board.
+// Endgames in the bitbases get their exact result from there
+int evaluate_board(Board *board, PawnEntry *pawn_table){
+    int known;
+    if(bitbase_evaluate(board, &known)) return known;
+    if(board->acc) return nnue_evaluate(board);
+
+    PawnEntry scratch;
+    const PawnEntry *pawns = probe_pawns(board, pawn_table, &scratch);
+    int mg = board->psq_mg + pawns->mg
+           + pawns->shelter[0][lsb(board->peice_bb[W_KING]) % 8] - pawns->shelter[1][lsb(board->peice_bb[B_KING]) % 8];
+    int eg = board->psq_eg + pawns->eg;
+
+    int phase = board->phase < MAX_PHASE ? board->phase : MAX_PHASE; // Early promotions can push it past the start
+    int score = (mg * phase + eg * (MAX_PHASE - phase)) / MAX_PHASE;
+    return score * board->to_move;
+}
+
+// ------- Transposition Table ---------- //
+
+#define TT_BUCKET_SIZE 4
+#define DEFAULT_HASH_MB 16
+
+enum Bound { BOUND_NONE = 0, BOUND_UPPER = 1, BOUND_LOWER = 2, BOUND_EXACT = 3 };
+
+// One slot of a bucket. The key is stored xor'ed with the data, so an entry half written by
+// another thread no longer matches its key and is read as a miss instead of as wrong data.
+// Data layout: move [0, 16) | score [16, 32) | depth [32, 40) | bound [40, 42) | generation [42, 48)
+typedef struct {
+    std::atomic<uint64_t> key_xor_data;
+    std::atomic<uint64_t> data;
+} TTEntry;
+
+// Four entries fill one 64 byte cache line
+typedef struct alignas(64) {
+    TTEntry entries[TT_BUCKET_SIZE];
+} TTBucket;
+
+typedef struct {
+    TTBucket *buckets;
+    uint64_t num_buckets;
+    int generation; // Bumped once per search so stale entries are replaced first
+} TranspositionTable;
+
+// Result of a successful probe
+typedef struct {
+    Move move;
+    int score;
+    int depth;
+    int bound;
+} TTHit;
+
+void tt_clear(TranspositionTable *table){
+    memset((void *)table->buckets, 0, table->num_buckets * sizeof(TTBucket));
+    table->generation = 0;
+}
+
+// Reallocates the table to the largest bucket count fitting in size_mb megabytes
+void tt_resize(TranspositionTable *table, int size_mb){
+    if(size_mb < 1) size_mb = 1;
+    free(table->buckets);
+    table->num_buckets = ((uint64_t)size_mb << 20) / sizeof(TTBucket);
+    table->buckets = (TTBucket *)aligned_alloc(sizeof(TTBucket), table->num_buckets * sizeof(TTBucket));
+    tt_clear(table);
+}
+
+void tt_new_search(TranspositionTable *table){
+    table->generation = (table->generation + 1) & 0x3F;
+}
+
+static inline TTBucket *tt_bucket(TranspositionTable *table, uint64_t key){
+    return &table->buckets[(uint64_t)(((unsigned __int128)key * table->num_buckets) >> 64)];
+}
+
+bool tt_probe(TranspositionTable *table, uint64_t key, TTHit *hit){
+    TTBucket *bucket = tt_bucket(table, key);
+    for(int i=0; i<TT_BUCKET_SIZE; i++){
+        uint64_t data = bucket->entries[i].data.load(std::memory_order_relaxed);
+        uint64_t check = bucket->entries[i].key_xor_data.load(std::memory_order_relaxed);
+        if((check ^ data) == key && ((data >> 40) & 0x3) != BOUND_NONE){
+            hit->move = (Move)data;
+            hit->score = (int16_t)(data >> 16);
+            hit->depth = (int)((data >> 32) & 0xFF);
+            hit->bound = (int)((data >> 40) & 0x3);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Stores a search result. Within the bucket it overwrites the same position, or else the
+// entry whose depth is least worth keeping once its age is taken into account.
+void tt_store(TranspositionTable *table, uint64_t key, int depth, int score, int bound, Move move){
+    TTBucket *bucket = tt_bucket(table, key);
+    TTEntry *replace = &bucket->entries[0];
+    int replace_worth = INFINITY;
+    uint64_t old_data = 0;
+
+    for(int i=0; i<TT_BUCKET_SIZE; i++){
+        TTEntry *entry = &bucket->entries[i];
+        uint64_t data = entry->data.load(std::memory_order_relaxed);
+        uint64_t check = entry->key_xor_data.load(std::memory_order_relaxed);
+        if((check ^ data) == key){
+            replace = entry;
+            old_data = data;
+            break;
+        }
+        int age = (table->generation - (int)((data >> 42) & 0x3F)) & 0x3F;
+        int worth = (int)((data >> 32) & 0xFF) - 8 * age;
+        if(worth < replace_worth){
+            replace_worth = worth;
+            replace = entry;
+        }
+    }
+
+    // Keep the move of a previous search of this position if the new result has none
+    if(move == MOVE_NONE && old_data != 0) move = (Move)old_data;
+
+    uint64_t data = (uint64_t)move
+                  | ((uint64_t)(uint16_t)(int16_t)score << 16)
+                  | ((uint64_t)(depth & 0xFF) << 32)
+                  | ((uint64_t)(bound & 0x3) << 40)
+                  | ((uint64_t)(table->generation & 0x3F) << 42);
+    replace->key_xor_data.store(key ^ data, std::memory_order_relaxed);
+    replace->data.store(data, std::memory_order_relaxed);
+}
+
+// Mate scores are stored relative to the node so they stay valid at any ply
+static inline int score_to_tt(int score, int ply){
+    return score >= MATE_SCORE - MAX_PLY ? score + ply : score <= -MATE_SCORE + MAX_PLY ? score - ply : score;
+}
+
+static inline int score_from_tt(int score, int ply){
+    return score >= MATE_SCORE - MAX_PLY ? score - ply : score <= -MATE_SCORE + MAX_PLY ? score + ply : score;
+}
+
+void network_unload(Network *net){
+    if(net->mapping) munmap(net->mapping, net->mapping_size);
+    memset(net, 0, sizeof(Network));
+}
+
+// Maps the weight file, nothing is copied so loading takes no time and every search thread shares the pages
+// Returns 1 on success, 0 (leaving net empty) if the file is missing or malformed. Not to be called during a search
+int network_load(Network *net, const char *path){
+    network_unload(net);
+
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return 0;
+    struct stat st;
+    size_t expected = 8 + sizeof(int16_t) * ((size_t)NNUE_FEATURES * NNUE_HIDDEN + NNUE_HIDDEN + 2 * NNUE_HIDDEN + 1);
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size != expected){
+        close(fd);
+        return 0;
+    }
+    void *mapping = mmap(NULL, expected, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED) return 0;
+
+    const char *bytes = (const char *)mapping;
+    uint32_t hidden;
+    memcpy(&hidden, bytes + 4, sizeof(hidden));
+    if(memcmp(bytes, "CNUE", 4) != 0 || hidden != NNUE_HIDDEN){
+        munmap(mapping, expected);
+        return 0;
+    }
+
+    const int16_t *weights = (const int16_t *)(bytes + 8);
+    net->feature_weights = weights;
+    net->feature_bias = weights + NNUE_FEATURES * NNUE_HIDDEN;
+    net->output_weights = net->feature_bias + NNUE_HIDDEN;
+    net->output_bias = net->output_weights[2 * NNUE_HIDDEN];
+    net->mapping = mapping;
+    net->mapping_size = expected;
+    return 1;
+}
+
+// --------------------- //
+
+// ------- Move Ordering ---------- //
+#define MAX_HISTORY 16384
+
+enum PickerStage {
+    STAGE_TT_MOVE, STAGE_GEN_CAPTURES, STAGE_CAPTURES, STAGE_KILLERS,
+    STAGE_GEN_QUIETS, STAGE_QUIETS, STAGE_BAD_CAPTURES, STAGE_DONE
+};
+
+// Hands out the moves of one node a stage at a time, so a cutoff on the table move or a
+// capture never pays for generating and scoring the quiet moves
+// Captures that lose material by SEE are kept at the front of moves[] and tried after the quiets,
+// or dropped altogether in quiescence
+typedef struct {
+    Board *board;
+    SearchContext *ctx;
+    int ply;
+    int stage;
+    bool quiescence; // Only the table move if tactical, then winning and equal captures
+    Move tt_move;
+    int killer_index;
+    Move *moves; // This ply's slices of the context move and score lists
+    int *scores;
+    int num_moves;
+    int current;
+    int num_bad_captures;
+} MovePicker;
+
+// True if move is legal in this position
+// Table moves and killers come from other positions and have to be checked before use
+bool move_is_legal(Board *board, Move move){
+    int from = move_from(move), to = move_to(move), kind = move_kind(move);
+    int side = board->to_move, us = COLOR_INDEX(side);
+    int peice = board->squares[from];
+    int captured = board->squares[to];
+    uint64_t to_bb = SQUARE_BB(to);
+
+    if(move == MOVE_NONE || peice == EMPTY || PEICE_COLOR(peice) != us || (board->color_bb[us] & to_bb)) return false;
+    if(PEICE_TYPE(peice) != W_PAWN && (kind == MOVE_PROMOTION || kind == MOVE_EN_PASSANT)) return false;
+    if(PEICE_TYPE(peice) != W_KING && kind == MOVE_CASTLING) return false;
+
+    switch(PEICE_TYPE(peice)){
+        case W_PAWN: {
+            int up = (side == 1) ? 8 : -8;
+            if((to >= 56 || to < 8) != (kind == MOVE_PROMOTION)) return false;
+            if(to == from + up){
+                if(captured != EMPTY || kind == MOVE_EN_PASSANT) return false;
+            }
+            else if(to == from + 2 * up){
+                if(captured != EMPTY || kind == MOVE_EN_PASSANT || board->squares[from + up] != EMPTY || from / 8 != (side == 1 ? 1 : 6)) return false;
+            }
+            else if(pawn_attacks[us][from] & to_bb){
+                if((kind == MOVE_EN_PASSANT) != (to == board->en_passant)) return false;
+                if(kind != MOVE_EN_PASSANT && captured == EMPTY) return false;
+            }
+            else return false;
+            break;
+        }
+        case W_KNIGHT: if(!(knight_attacks[from] & to_bb)) return false; break;
+        case W_BISHOP: if(!(bishop_attacks(from, board->occupied) & to_bb)) return false; break;
+        case W_ROOK: if(!(rook_attacks(from, board->occupied) & to_bb)) return false; break;
+        case W_QUEEN: if(!(queen_attacks(from, board->occupied) & to_bb)) return false; break;
+        default:
+            if(kind == MOVE_CASTLING){
+                // can_castle already checked every square
+                return from == (side == 1 ? 4 : 60) && (to == from + 2 || to == from - 2) && can_castle(board, to > from);
+            }
+            if(!(king_attacks[from] & to_bb)) return false;
+    }
+
+    StateInfo state;
+    apply_move(board, move, &state);
+    bool legal = !in_check(board, side);
+    undo_move(board, move, &state);
+    return legal;
+}
+
+// Static exchange evaluation: material balance of the capture sequence on the target square, where each side
+// always recaptures with its least valuable attacker and may stop when recapturing loses
+// Sliders behind the capturing peices join in as the squares in front of them are vacated
+int see(Board *board, Move move){
+    int from = move_from(move), to = move_to(move);
+    int peice = board->squares[from];
+    int captured = captured_peice(board, move);
+    int gain[32], d = 0;
+    uint64_t occupied = board->occupied ^ SQUARE_BB(from);
+    if(move_kind(move) == MOVE_EN_PASSANT){
+        occupied ^= SQUARE_BB(to + (PEICE_COLOR(peice) == 0 ? -8 : 8));
+    }
+
+    gain[0] = (captured != EMPTY) ? PEICE_VALUES[PEICE_TYPE(captured)] : 0;
+    int on_square = PEICE_TYPE(peice);
+    if(move_kind(move) == MOVE_PROMOTION){
+        gain[0] += PEICE_VALUES[promotion_type(move)] - PEICE_VALUES[W_PAWN];
+        on_square = promotion_type(move);
+    }
+
+    uint64_t bishops = board->peice_bb[W_BISHOP] | board->peice_bb[B_BISHOP] | board->peice_bb[W_QUEEN] | board->peice_bb[B_QUEEN];
+    uint64_t rooks = board->peice_bb[W_ROOK] | board->peice_bb[B_ROOK] | board->peice_bb[W_QUEEN] | board->peice_bb[B_QUEEN];
+    uint64_t attackers = attackers_to(board, to, occupied) & occupied;
+    int color = PEICE_COLOR(peice) ^ 1;
+
+    while(d < 31){
+        uint64_t own_attackers = attackers & board->color_bb[color];
+        if(!own_attackers) break;
+
+        // Least valuable attacker
+        int base = (color == 0) ? W_PAWN : B_PAWN;
+        int type = 0;
+        uint64_t from_bb = 0;
+        for(type = W_PAWN; type <= W_KING; type++){
+            from_bb = own_attackers & board->peice_bb[base + type - W_PAWN];
+            if(from_bb) break;
+        }
+
+        // A king cannot capture into a square the other side still defends
+        if(type == W_KING && (attackers & board->color_bb[color ^ 1])) break;
+
+        d++;
+        gain[d] = PEICE_VALUES[on_square] - gain[d - 1];
+        if((gain[d] > -gain[d - 1] ? gain[d] : -gain[d - 1]) < 0){
+            d--; // Neither side can gain any more, and this capture is not made
+            break;
+        }
+
+        occupied ^= from_bb & (~from_bb + 1);
+        if(type == W_PAWN || type == W_BISHOP || type == W_QUEEN) attackers |= bishop_attacks(to, occupied) & bishops;
+        if(type == W_ROOK || type == W_QUEEN) attackers |= rook_attacks(to, occupied) & rooks;
+        attackers &= occupied;
+        on_square = type;
+        color ^= 1;
+    }
+
+    while(d > 0){
+        gain[d - 1] = -(-gain[d - 1] > gain[d] ? -gain[d - 1] : gain[d]);
+        d--;
+    }
+    return gain[0];
+}
+
+// Most valuable victim first, least valuable attacker breaking ties, promotions count as captures
+static inline int mvv_lva(const Board *board, Move move){
+    int captured = captured_peice(board, move);
+    int victim = (captured != EMPTY) ? PEICE_VALUES[PEICE_TYPE(captured)] : 0;
+    int promotion = (move_kind(move) == MOVE_PROMOTION) ? PEICE_VALUES[promotion_type(move)] : 0;
+    return 16 * (victim + promotion) - PEICE_TYPE(board->squares[move_from(move)]);
+}
+
+void init_move_picker(MovePicker *mp, Board *board, SearchContext *ctx, Move tt_move, int ply, bool quiescence){
+    mp->board = board;
+    mp->ctx = ctx;
+    mp->ply = ply;
+    mp->moves = ctx->move_lists[ply];
+    mp->scores = ctx->score_lists[ply];
+    mp->quiescence = quiescence;
+    mp->tt_move = tt_move;
+    mp->stage = tt_move ? STAGE_TT_MOVE : STAGE_GEN_CAPTURES;
+    mp->killer_index = 0;
+    mp->num_moves = mp->current = mp->num_bad_captures = 0;
+}
+
+// Selection step: brings the best scored remaining move to the front, only paid for moves actually searched
+static Move pick_best(MovePicker *mp){
+    int best = mp->current;
+    for(int i=mp->current + 1; i<mp->num_moves; i++){
+        if(mp->scores[i] > mp->scores[best]) best = i;
+    }
+    Move move = mp->moves[best];
+    int score = mp->scores[best];
+    mp->moves[best] = mp->moves[mp->current];
+    mp->scores[best] = mp->scores[mp->current];
+    mp->moves[mp->current] = move;
+    mp->scores[mp->current] = score;
+    mp->current++;
+    return move;
+}
+
+// Index into SearchStats.stage_cutoffs of the stage the move next_move just returned came from
+static inline int cutoff_stage(MovePicker *mp){
+    switch(mp->stage){
+        case STAGE_GEN_CAPTURES: return 0; // Moved on right after handing out the table move
+        case STAGE_CAPTURES: return 1;
+        case STAGE_KILLERS: return 2;
+        case STAGE_QUIETS: return 3;
+        default: return 4;
+    }
+}
+
+static bool is_killer(MovePicker *mp, Move move){
+    return move == mp->ctx->killers[mp->ply][0] || move == mp->ctx->killers[mp->ply][1];
+}
+
+// Fills *move with the next move to search, returns false once every move has been handed out
+bool next_move(MovePicker *mp, Move *move){
+    while(true){
+        switch(mp->stage){
+            case STAGE_TT_MOVE:
+                mp->stage = STAGE_GEN_CAPTURES;
+                if(move_is_legal(mp->board, mp->tt_move)
+                    && (!mp->quiescence || (is_tactical(mp->board, mp->tt_move) && see(mp->board, mp->tt_move) >= 0))){
+                    *move = mp->tt_move;
+                    return true;
+                }
+                mp->tt_move = MOVE_NONE;
+                break;
+
+            case STAGE_GEN_CAPTURES:
+                mp->num_moves = generate_moves(mp->board, mp->moves, GEN_CAPTURES);
+                for(int i=0; i<mp->num_moves; i++){
+                    mp->scores[i] = mvv_lva(mp->board, mp->moves[i]);
+                }
+                mp->current = 0;
+                mp->stage = STAGE_CAPTURES;
+                break;
+
+            case STAGE_CAPTURES:
+                while(mp->current < mp->num_moves){
+                    Move next = pick_best(mp);
+                    if(next == mp->tt_move) continue;
+                    if(see(mp->board, next) < 0){
+                        mp->moves[mp->num_bad_captures++] = next; // Always behind current, nothing unpicked is overwritten
+                        continue;
+                    }
+                    *move = next;
+                    return true;
+                }
+                mp->stage = mp->quiescence ? STAGE_DONE : STAGE_KILLERS;
+                break;
+
+            case STAGE_KILLERS:
+                while(mp->killer_index < 2){
+                    Move killer = mp->ctx->killers[mp->ply][mp->killer_index++];
+                    if(killer != mp->tt_move && move_is_legal(mp->board, killer) && !is_tactical(mp->board, killer)){
+                        *move = killer;
+                        return true;
+                    }
+                }
+                mp->stage = STAGE_GEN_QUIETS;
+                break;
+
+            case STAGE_GEN_QUIETS: {
+                // Quiet moves go after the bad captures
+                mp->current = mp->num_bad_captures;
+                mp->num_moves = mp->current + generate_moves(mp->board, mp->moves + mp->current, GEN_QUIETS);
+                int (*history)[64] = mp->ctx->history[COLOR_INDEX(mp->board->to_move)];
+                for(int i=mp->current; i<mp->num_moves; i++){
+                    mp->scores[i] = history[move_from(mp->moves[i])][move_to(mp->moves[i])];
+                }
+                mp->stage = STAGE_QUIETS;
+                break;
+            }
+
+            case STAGE_QUIETS:
+                while(mp->current < mp->num_moves){
+                    Move next = pick_best(mp);
+                    if(next != mp->tt_move && !is_killer(mp, next)){
+                        *move = next;
+                        return true;
+                    }
+                }
+                mp->current = 0;
+                mp->stage = STAGE_BAD_CAPTURES;
+                break;
+
+            case STAGE_BAD_CAPTURES:
+                if(mp->current < mp->num_bad_captures){
+                    *move = mp->moves[mp->current++];
+                    return true;
+                }
+                mp->stage = STAGE_DONE;
+                break;
+
+            default:
+                return false;
+        }
+    }
+}
+
+// History gravity keeps every entry within +-MAX_HISTORY however often it is updated
+static inline void update_history(int *entry, int bonus){
+    *entry += bonus - *entry * abs(bonus) / MAX_HISTORY;
+}
+
+// A quiet move caused a cutoff: make it a killer for this ply, reward it and punish the quiets tried before it
+static void update_quiet_heuristics(SearchContext *ctx, Board *board, Move move, int ply, int depth, Move *quiets, int num_quiets){
+    if(ctx->killers[ply][0] != move){
+        ctx->killers[ply][1] = ctx->killers[ply][0];
+        ctx->killers[ply][0] = move;
+    }
+
+    int (*history)[64] = ctx->history[COLOR_INDEX(board->to_move)];
+    int bonus = depth * depth > 400 ? 400 * 16 : depth * depth * 16;
+    update_history(&history[move_from(move)][move_to(move)], bonus);
+    for(int i=0; i<num_quiets; i++){
+        update_history(&history[move_from(quiets[i])][move_to(quiets[i])], -bonus);
+    }
+}
+
+// --------------------- //
+
+// ------- Time Management ---------- //
+
+#define TIME_CHECK_INTERVAL 1024 // Nodes between two reads of the clock by the main thread
+#define MOVE_OVERHEAD 0.05 // Seconds lost on every move to Python and the ctypes call
+
+static inline double seconds_since(TimePoint start){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// time_left is what remains on the game clock and per_move_time the most this move may take, either may be 0 when
+// there is no such limit. The soft limit aims to spread time_left over the moves still expected in the game,
+// the hard limit allows a few times that for unstable positions without risking the clock. per_move_time caps both
+void time_manager_init(TimeManager *tm, double time_left, double per_move_time, int move_number){
+    tm->start = std::chrono::steady_clock::now();
+    int moves_to_go = move_number < 60 ? 40 - move_number / 2 : 10;
+    double usable = time_left > MOVE_OVERHEAD ? time_left - MOVE_OVERHEAD : 0;
+    double move_budget = per_move_time - MOVE_OVERHEAD;
+
+    tm->soft_limit = usable / moves_to_go;
+    tm->hard_limit = usable * 0.3;
+    if(tm->hard_limit > 5 * tm->soft_limit) tm->hard_limit = 5 * tm->soft_limit;
+    if(per_move_time > 0){
+        // Without a clock the move budget is both limits
+        if(time_left <= 0) tm->soft_limit = tm->hard_limit = move_budget;
+        if(tm->hard_limit > move_budget) tm->hard_limit = move_budget;
+    }
+    if(tm->soft_limit > tm->hard_limit) tm->soft_limit = tm->hard_limit;
+    if(tm->hard_limit < 0.01) tm->hard_limit = tm->soft_limit = 0.01;
+
+    tm->last_iteration = tm->prev_iteration = 0;
+    tm->instability = 0;
+    tm->node_limit = UINT64_MAX;
+    tm->depth_limit = MAX_DEPTH;
+}
+
+// A fixed budget of seconds and/or nodes for one search, 0 for no limit of that kind
+void time_manager_fixed(TimeManager *tm, double seconds, uint64_t nodes){
+    tm->start = std::chrono::steady_clock::now();
+    tm->soft_limit = tm->hard_limit = seconds > 0 ? seconds : 1e9;
+    tm->last_iteration = tm->prev_iteration = 0;
+    tm->instability = 0;
+    tm->node_limit = nodes > 0 ? nodes : UINT64_MAX;
+    tm->depth_limit = MAX_DEPTH;
+}
+
+// Called by the main thread after each completed iteration, true if the next one should not be started
+// because it is predicted to run past the hard limit or the soft limit has already been used up
+bool time_manager_stop(TimeManager *tm, double iteration_time, int best_move_changes){
+    tm->prev_iteration = tm->last_iteration;
+    tm->last_iteration = iteration_time;
+    tm->instability = tm->instability / 2 + best_move_changes;
+
+    double elapsed = seconds_since(tm->start);
+    double scale = 1.0 + (tm->instability > 3 ? 3 : tm->instability) / 2;
+    if(elapsed > tm->soft_limit * scale) return true;
+
+    double growth = tm->prev_iteration > 0.001 ? tm->last_iteration / tm->prev_iteration : 4.0;
+    growth = growth < 1.5 ? 1.5 : growth > 8.0 ? 8.0 : growth;
+    return elapsed + tm->last_iteration * growth > tm->hard_limit;
+}
+
+// True once this search has to stop. Only the main thread checks the limits, the clock every
+// TIME_CHECK_INTERVAL nodes, and the stop flag carries its decision to the helpers
+static inline bool out_of_time(SearchContext *ctx){
+    return ctx->shared->stop.load(std::memory_order_relaxed);
+}
+
+static inline void count_node(SearchContext *ctx){
+    ++ctx->nodes;
+    if(ctx->thread_id != 0) return;
+    TimeManager *tm = &ctx->shared->tm;
+    if(ctx->nodes >= tm->node_limit
+        || ((ctx->nodes % TIME_CHECK_INTERVAL) == 0 && seconds_since(tm->start) > tm->hard_limit)){
+        ctx->shared->stop.store(true, std::memory_order_relaxed);
+    }
+}
+
+// --------------------- //
+
+// ------- Opening Book ---------- //
+// Polyglot .bin books: 16 byte big endian entries (key, move, weight, learn) sorted by key.
+// Polyglot hashes positions with its own fixed keys, independent of zobrist_peice
+
+// Indexed by 64 * kind + square, kind being 2 * (peice type - 1) plus 1 for white, then the extras below
+const uint64_t POLYGLOT_RANDOM[781] = {
+    0x9D39247E33776D41ULL, 0x2AF7398005AAA5C7ULL, 0x44DB015024623547ULL, 0x9C15F73E62A76AE2ULL,
+    0x75834465489C0C89ULL, 0x3290AC3A203001BFULL, 0x0FBBAD1F61042279ULL, 0xE83A908FF2FB60CAULL,
+    0x0D7E765D58755C10ULL, 0x1A083822CEAFE02DULL, 0x9605D5F0E25EC3B0ULL, 0xD021FF5CD13A2ED5ULL,
+    0x40BDF15D4A672E32ULL, 0x011355146FD56395ULL, 0x5DB4832046F3D9E5ULL, 0x239F8B2D7FF719CCULL,
+    0x05D1A1AE85B49AA1ULL, 0x679F848F6E8FC971ULL, 0x7449BBFF801FED0BULL, 0x7D11CDB1C3B7ADF0ULL,
+    0x82C7709E781EB7CCULL, 0xF3218F1C9510786CULL, 0x331478F3AF51BBE6ULL, 0x4BB38DE5E7219443ULL,
+    0xAA649C6EBCFD50FCULL, 0x8DBD98A352AFD40BULL, 0x87D2074B81D79217ULL, 0x19F3C751D3E92AE1ULL,
+    0xB4AB30F062B19ABFULL, 0x7B0500AC42047AC4ULL, 0xC9452CA81A09D85DULL, 0x24AA6C514DA27500ULL,
+    0x4C9F34427501B447ULL, 0x14A68FD73C910841ULL, 0xA71B9B83461CBD93ULL, 0x03488B95B0F1850FULL,
+    0x637B2B34FF93C040ULL, 0x09D1BC9A3DD90A94ULL, 0x3575668334A1DD3BULL, 0x735E2B97A4C45A23ULL,
+    0x18727070F1BD400BULL, 0x1FCBACD259BF02E7ULL, 0xD310A7C2CE9B6555ULL, 0xBF983FE0FE5D8244ULL,
+    0x9F74D14F7454A824ULL, 0x51EBDC4AB9BA3035ULL, 0x5C82C505DB9AB0FAULL, 0xFCF7FE8A3430B241ULL,
+    0x3253A729B9BA3DDEULL, 0x8C74C368081B3075ULL, 0xB9BC6C87167C33E7ULL, 0x7EF48F2B83024E20ULL,
+    0x11D505D4C351BD7FULL, 0x6568FCA92C76A243ULL, 0x4DE0B0F40F32A7B8ULL, 0x96D693460CC37E5DULL,
+    0x42E240CB63689F2FULL, 0x6D2BDCDAE2919661ULL, 0x42880B0236E4D951ULL, 0x5F0F4A5898171BB6ULL,
+    0x39F890F579F92F88ULL, 0x93C5B5F47356388BULL, 0x63DC359D8D231B78ULL, 0xEC16CA8AEA98AD76ULL,
+    0x5355F900C2A82DC7ULL, 0x07FB9F855A997142ULL, 0x5093417AA8A7ED5EULL, 0x7BCBC38DA25A7F3CULL,
+    0x19FC8A768CF4B6D4ULL, 0x637A7780DECFC0D9ULL, 0x8249A47AEE0E41F7ULL, 0x79AD695501E7D1E8ULL,
+    0x14ACBAF4777D5776ULL, 0xF145B6BECCDEA195ULL, 0xDABF2AC8201752FCULL, 0x24C3C94DF9C8D3F6ULL,
+    0xBB6E2924F03912EAULL, 0x0CE26C0B95C980D9ULL, 0xA49CD132BFBF7CC4ULL, 0xE99D662AF4243939ULL,
+    0x27E6AD7891165C3FULL, 0x8535F040B9744FF1ULL, 0x54B3F4FA5F40D873ULL, 0x72B12C32127FED2BULL,
+    0xEE954D3C7B411F47ULL, 0x9A85AC909A24EAA1ULL, 0x70AC4CD9F04F21F5ULL, 0xF9B89D3E99A075C2ULL,
+    0x87B3E2B2B5C907B1ULL, 0xA366E5B8C54F48B8ULL, 0xAE4A9346CC3F7CF2ULL, 0x1920C04D47267BBDULL,
+    0x87BF02C6B49E2AE9ULL, 0x092237AC237F3859ULL, 0xFF07F64EF8ED14D0ULL, 0x8DE8DCA9F03CC54EULL,
+    0x9C1633264DB49C89ULL, 0xB3F22C3D0B0B38EDULL, 0x390E5FB44D01144BULL, 0x5BFEA5B4712768E9ULL,
+    0x1E1032911FA78984ULL, 0x9A74ACB964E78CB3ULL, 0x4F80F7A035DAFB04ULL, 0x6304D09A0B3738C4ULL,
+    0x2171E64683023A08ULL, 0x5B9B63EB9CEFF80CULL, 0x506AACF489889342ULL, 0x1881AFC9A3A701D6ULL,
+    0x6503080440750644ULL, 0xDFD395339CDBF4A7ULL, 0xEF927DBCF00C20F2ULL, 0x7B32F7D1E03680ECULL,
+    0xB9FD7620E7316243ULL, 0x05A7E8A57DB91B77ULL, 0xB5889C6E15630A75ULL, 0x4A750A09CE9573F7ULL,
+    0xCF464CEC899A2F8AULL, 0xF538639CE705B824ULL, 0x3C79A0FF5580EF7FULL, 0xEDE6C87F8477609DULL,
+    0x799E81F05BC93F31ULL, 0x86536B8CF3428A8CULL, 0x97D7374C60087B73ULL, 0xA246637CFF328532ULL,
+    0x043FCAE60CC0EBA0ULL, 0x920E449535DD359EULL, 0x70EB093B15B290CCULL, 0x73A1921916591CBDULL,
+    0x56436C9FE1A1AA8DULL, 0xEFAC4B70633B8F81ULL, 0xBB215798D45DF7AFULL, 0x45F20042F24F1768ULL,
+    0x930F80F4E8EB7462ULL, 0xFF6712FFCFD75EA1ULL, 0xAE623FD67468AA70ULL, 0xDD2C5BC84BC8D8FCULL,
+    0x7EED120D54CF2DD9ULL, 0x22FE545401165F1CULL, 0xC91800E98FB99929ULL, 0x808BD68E6AC10365ULL,
+    0xDEC468145B7605F6ULL, 0x1BEDE3A3AEF53302ULL, 0x43539603D6C55602ULL, 0xAA969B5C691CCB7AULL,
+    0xA87832D392EFEE56ULL, 0x65942C7B3C7E11AEULL, 0xDED2D633CAD004F6ULL, 0x21F08570F420E565ULL,
+    0xB415938D7DA94E3CULL, 0x91B859E59ECB6350ULL, 0x10CFF333E0ED804AULL, 0x28AED140BE0BB7DDULL,
+    0xC5CC1D89724FA456ULL, 0x5648F680F11A2741ULL, 0x2D255069F0B7DAB3ULL, 0x9BC5A38EF729ABD4ULL,
+    0xEF2F054308F6A2BCULL, 0xAF2042F5CC5C2858ULL, 0x480412BAB7F5BE2AULL, 0xAEF3AF4A563DFE43ULL,
+    0x19AFE59AE451497FULL, 0x52593803DFF1E840ULL, 0xF4F076E65F2CE6F0ULL, 0x11379625747D5AF3ULL,
+    0xBCE5D2248682C115ULL, 0x9DA4243DE836994FULL, 0x066F70B33FE09017ULL, 0x4DC4DE189B671A1CULL,
+    0x51039AB7712457C3ULL, 0xC07A3F80C31FB4B4ULL, 0xB46EE9C5E64A6E7CULL, 0xB3819A42ABE61C87ULL,
+    0x21A007933A522A20ULL, 0x2DF16F761598AA4FULL, 0x763C4A1371B368FDULL, 0xF793C46702E086A0ULL,
+    0xD7288E012AEB8D31ULL, 0xDE336A2A4BC1C44BULL, 0x0BF692B38D079F23ULL, 0x2C604A7A177326B3ULL,
+    0x4850E73E03EB6064ULL, 0xCFC447F1E53C8E1BULL, 0xB05CA3F564268D99ULL, 0x9AE182C8BC9474E8ULL,
+    0xA4FC4BD4FC5558CAULL, 0xE755178D58FC4E76ULL, 0x69B97DB1A4C03DFEULL, 0xF9B5B7C4ACC67C96ULL,
+    0xFC6A82D64B8655FBULL, 0x9C684CB6C4D24417ULL, 0x8EC97D2917456ED0ULL, 0x6703DF9D2924E97EULL,
+    0xC547F57E42A7444EULL, 0x78E37644E7CAD29EULL, 0xFE9A44E9362F05FAULL, 0x08BD35CC38336615ULL,
+    0x9315E5EB3A129ACEULL, 0x94061B871E04DF75ULL, 0xDF1D9F9D784BA010ULL, 0x3BBA57B68871B59DULL,
+    0xD2B7ADEEDED1F73FULL, 0xF7A255D83BC373F8ULL, 0xD7F4F2448C0CEB81ULL, 0xD95BE88CD210FFA7ULL,
+    0x336F52F8FF4728E7ULL, 0xA74049DAC312AC71ULL, 0xA2F61BB6E437FDB5ULL, 0x4F2A5CB07F6A35B3ULL,
+    0x87D380BDA5BF7859ULL, 0x16B9F7E06C453A21ULL, 0x7BA2484C8A0FD54EULL, 0xF3A678CAD9A2E38CULL,
+    0x39B0BF7DDE437BA2ULL, 0xFCAF55C1BF8A4424ULL, 0x18FCF680573FA594ULL, 0x4C0563B89F495AC3ULL,
+    0x40E087931A00930DULL, 0x8CFFA9412EB642C1ULL, 0x68CA39053261169FULL, 0x7A1EE967D27579E2ULL,
+    0x9D1D60E5076F5B6FULL, 0x3810E399B6F65BA2ULL, 0x32095B6D4AB5F9B1ULL, 0x35CAB62109DD038AULL,
+    0xA90B24499FCFAFB1ULL, 0x77A225A07CC2C6BDULL, 0x513E5E634C70E331ULL, 0x4361C0CA3F692F12ULL,
+    0xD941ACA44B20A45BULL, 0x528F7C8602C5807BULL, 0x52AB92BEB9613989ULL, 0x9D1DFA2EFC557F73ULL,
+    0x722FF175F572C348ULL, 0x1D1260A51107FE97ULL, 0x7A249A57EC0C9BA2ULL, 0x04208FE9E8F7F2D6ULL,
+    0x5A110C6058B920A0ULL, 0x0CD9A497658A5698ULL, 0x56FD23C8F9715A4CULL, 0x284C847B9D887AAEULL,
+    0x04FEABFBBDB619CBULL, 0x742E1E651C60BA83ULL, 0x9A9632E65904AD3CULL, 0x881B82A13B51B9E2ULL,
+    0x506E6744CD974924ULL, 0xB0183DB56FFC6A79ULL, 0x0ED9B915C66ED37EULL, 0x5E11E86D5873D484ULL,
+    0xF678647E3519AC6EULL, 0x1B85D488D0F20CC5ULL, 0xDAB9FE6525D89021ULL, 0x0D151D86ADB73615ULL,
+    0xA865A54EDCC0F019ULL, 0x93C42566AEF98FFBULL, 0x99E7AFEABE000731ULL, 0x48CBFF086DDF285AULL,
+    0x7F9B6AF1EBF78BAFULL, 0x58627E1A149BBA21ULL, 0x2CD16E2ABD791E33ULL, 0xD363EFF5F0977996ULL,
+    0x0CE2A38C344A6EEDULL, 0x1A804AADB9CFA741ULL, 0x907F30421D78C5DEULL, 0x501F65EDB3034D07ULL,
+    0x37624AE5A48FA6E9ULL, 0x957BAF61700CFF4EULL, 0x3A6C27934E31188AULL, 0xD49503536ABCA345ULL,
+    0x088E049589C432E0ULL, 0xF943AEE7FEBF21B8ULL, 0x6C3B8E3E336139D3ULL, 0x364F6FFA464EE52EULL,
+    0xD60F6DCEDC314222ULL, 0x56963B0DCA418FC0ULL, 0x16F50EDF91E513AFULL, 0xEF1955914B609F93ULL,
+    0x565601C0364E3228ULL, 0xECB53939887E8175ULL, 0xBAC7A9A18531294BULL, 0xB344C470397BBA52ULL,
+    0x65D34954DAF3CEBDULL, 0xB4B81B3FA97511E2ULL, 0xB422061193D6F6A7ULL, 0x071582401C38434DULL,
+    0x7A13F18BBEDC4FF5ULL, 0xBC4097B116C524D2ULL, 0x59B97885E2F2EA28ULL, 0x99170A5DC3115544ULL,
+    0x6F423357E7C6A9F9ULL, 0x325928EE6E6F8794ULL, 0xD0E4366228B03343ULL, 0x565C31F7DE89EA27ULL,
+    0x30F5611484119414ULL, 0xD873DB391292ED4FULL, 0x7BD94E1D8E17DEBCULL, 0xC7D9F16864A76E94ULL,
+    0x947AE053EE56E63CULL, 0xC8C93882F9475F5FULL, 0x3A9BF55BA91F81CAULL, 0xD9A11FBB3D9808E4ULL,
+    0x0FD22063EDC29FCAULL, 0xB3F256D8ACA0B0B9ULL, 0xB03031A8B4516E84ULL, 0x35DD37D5871448AFULL,
+    0xE9F6082B05542E4EULL, 0xEBFAFA33D7254B59ULL, 0x9255ABB50D532280ULL, 0xB9AB4CE57F2D34F3ULL,
+    0x693501D628297551ULL, 0xC62C58F97DD949BFULL, 0xCD454F8F19C5126AULL, 0xBBE83F4ECC2BDECBULL,
+    0xDC842B7E2819E230ULL, 0xBA89142E007503B8ULL, 0xA3BC941D0A5061CBULL, 0xE9F6760E32CD8021ULL,
+    0x09C7E552BC76492FULL, 0x852F54934DA55CC9ULL, 0x8107FCCF064FCF56ULL, 0x098954D51FFF6580ULL,
+    0x23B70EDB1955C4BFULL, 0xC330DE426430F69DULL, 0x4715ED43E8A45C0AULL, 0xA8D7E4DAB780A08DULL,
+    0x0572B974F03CE0BBULL, 0xB57D2E985E1419C7ULL, 0xE8D9ECBE2CF3D73FULL, 0x2FE4B17170E59750ULL,
+    0x11317BA87905E790ULL, 0x7FBF21EC8A1F45ECULL, 0x1725CABFCB045B00ULL, 0x964E915CD5E2B207ULL,
+    0x3E2B8BCBF016D66DULL, 0xBE7444E39328A0ACULL, 0xF85B2B4FBCDE44B7ULL, 0x49353FEA39BA63B1ULL,
+    0x1DD01AAFCD53486AULL, 0x1FCA8A92FD719F85ULL, 0xFC7C95D827357AFAULL, 0x18A6A990C8B35EBDULL,
+    0xCCCB7005C6B9C28DULL, 0x3BDBB92C43B17F26ULL, 0xAA70B5B4F89695A2ULL, 0xE94C39A54A98307FULL,
+    0xB7A0B174CFF6F36EULL, 0xD4DBA84729AF48ADULL, 0x2E18BC1AD9704A68ULL, 0x2DE0966DAF2F8B1CULL,
+    0xB9C11D5B1E43A07EULL, 0x64972D68DEE33360ULL, 0x94628D38D0C20584ULL, 0xDBC0D2B6AB90A559ULL,
+    0xD2733C4335C6A72FULL, 0x7E75D99D94A70F4DULL, 0x6CED1983376FA72BULL, 0x97FCAACBF030BC24ULL,
+    0x7B77497B32503B12ULL, 0x8547EDDFB81CCB94ULL, 0x79999CDFF70902CBULL, 0xCFFE1939438E9B24ULL,
+    0x829626E3892D95D7ULL, 0x92FAE24291F2B3F1ULL, 0x63E22C147B9C3403ULL, 0xC678B6D860284A1CULL,
+    0x5873888850659AE7ULL, 0x0981DCD296A8736DULL, 0x9F65789A6509A440ULL, 0x9FF38FED72E9052FULL,
+    0xE479EE5B9930578CULL, 0xE7F28ECD2D49EECDULL, 0x56C074A581EA17FEULL, 0x5544F7D774B14AEFULL,
+    0x7B3F0195FC6F290FULL, 0x12153635B2C0CF57ULL, 0x7F5126DBBA5E0CA7ULL, 0x7A76956C3EAFB413ULL,
+    0x3D5774A11D31AB39ULL, 0x8A1B083821F40CB4ULL, 0x7B4A38E32537DF62ULL, 0x950113646D1D6E03ULL,
+    0x4DA8979A0041E8A9ULL, 0x3BC36E078F7515D7ULL, 0x5D0A12F27AD310D1ULL, 0x7F9D1A2E1EBE1327ULL,
+    0xDA3A361B1C5157B1ULL, 0xDCDD7D20903D0C25ULL, 0x36833336D068F707ULL, 0xCE68341F79893389ULL,
+    0xAB9090168DD05F34ULL, 0x43954B3252DC25E5ULL, 0xB438C2B67F98E5E9ULL, 0x10DCD78E3851A492ULL,
+    0xDBC27AB5447822BFULL, 0x9B3CDB65F82CA382ULL, 0xB67B7896167B4C84ULL, 0xBFCED1B0048EAC50ULL,
+    0xA9119B60369FFEBDULL, 0x1FFF7AC80904BF45ULL, 0xAC12FB171817EEE7ULL, 0xAF08DA9177DDA93DULL,
+    0x1B0CAB936E65C744ULL, 0xB559EB1D04E5E932ULL, 0xC37B45B3F8D6F2BAULL, 0xC3A9DC228CAAC9E9ULL,
+    0xF3B8B6675A6507FFULL, 0x9FC477DE4ED681DAULL, 0x67378D8ECCEF96CBULL, 0x6DD856D94D259236ULL,
+    0xA319CE15B0B4DB31ULL, 0x073973751F12DD5EULL, 0x8A8E849EB32781A5ULL, 0xE1925C71285279F5ULL,
+    0x74C04BF1790C0EFEULL, 0x4DDA48153C94938AULL, 0x9D266D6A1CC0542CULL, 0x7440FB816508C4FEULL,
+    0x13328503DF48229FULL, 0xD6BF7BAEE43CAC40ULL, 0x4838D65F6EF6748FULL, 0x1E152328F3318DEAULL,
+    0x8F8419A348F296BFULL, 0x72C8834A5957B511ULL, 0xD7A023A73260B45CULL, 0x94EBC8ABCFB56DAEULL,
+    0x9FC10D0F989993E0ULL, 0xDE68A2355B93CAE6ULL, 0xA44CFE79AE538BBEULL, 0x9D1D84FCCE371425ULL,
+    0x51D2B1AB2DDFB636ULL, 0x2FD7E4B9E72CD38CULL, 0x65CA5B96B7552210ULL, 0xDD69A0D8AB3B546DULL,
+    0x604D51B25FBF70E2ULL, 0x73AA8A564FB7AC9EULL, 0x1A8C1E992B941148ULL, 0xAAC40A2703D9BEA0ULL,
+    0x764DBEAE7FA4F3A6ULL, 0x1E99B96E70A9BE8BULL, 0x2C5E9DEB57EF4743ULL, 0x3A938FEE32D29981ULL,
+    0x26E6DB8FFDF5ADFEULL, 0x469356C504EC9F9DULL, 0xC8763C5B08D1908CULL, 0x3F6C6AF859D80055ULL,
+    0x7F7CC39420A3A545ULL, 0x9BFB227EBDF4C5CEULL, 0x89039D79D6FC5C5CULL, 0x8FE88B57305E2AB6ULL,
+    0xA09E8C8C35AB96DEULL, 0xFA7E393983325753ULL, 0xD6B6D0ECC617C699ULL, 0xDFEA21EA9E7557E3ULL,
+    0xB67C1FA481680AF8ULL, 0xCA1E3785A9E724E5ULL, 0x1CFC8BED0D681639ULL, 0xD18D8549D140CAEAULL,
+    0x4ED0FE7E9DC91335ULL, 0xE4DBF0634473F5D2ULL, 0x1761F93A44D5AEFEULL, 0x53898E4C3910DA55ULL,
+    0x734DE8181F6EC39AULL, 0x2680B122BAA28D97ULL, 0x298AF231C85BAFABULL, 0x7983EED3740847D5ULL,
+    0x66C1A2A1A60CD889ULL, 0x9E17E49642A3E4C1ULL, 0xEDB454E7BADC0805ULL, 0x50B704CAB602C329ULL,
+    0x4CC317FB9CDDD023ULL, 0x66B4835D9EAFEA22ULL, 0x219B97E26FFC81BDULL, 0x261E4E4C0A333A9DULL,
+    0x1FE2CCA76517DB90ULL, 0xD7504DFA8816EDBBULL, 0xB9571FA04DC089C8ULL, 0x1DDC0325259B27DEULL,
+    0xCF3F4688801EB9AAULL, 0xF4F5D05C10CAB243ULL, 0x38B6525C21A42B0EULL, 0x36F60E2BA4FA6800ULL,
+    0xEB3593803173E0CEULL, 0x9C4CD6257C5A3603ULL, 0xAF0C317D32ADAA8AULL, 0x258E5A80C7204C4BULL,
+    0x8B889D624D44885DULL, 0xF4D14597E660F855ULL, 0xD4347F66EC8941C3ULL, 0xE699ED85B0DFB40DULL,
+    0x2472F6207C2D0484ULL, 0xC2A1E7B5B459AEB5ULL, 0xAB4F6451CC1D45ECULL, 0x63767572AE3D6174ULL,
+    0xA59E0BD101731A28ULL, 0x116D0016CB948F09ULL, 0x2CF9C8CA052F6E9FULL, 0x0B090A7560A968E3ULL,
+    0xABEEDDB2DDE06FF1ULL, 0x58EFC10B06A2068DULL, 0xC6E57A78FBD986E0ULL, 0x2EAB8CA63CE802D7ULL,
+    0x14A195640116F336ULL, 0x7C0828DD624EC390ULL, 0xD74BBE77E6116AC7ULL, 0x804456AF10F5FB53ULL,
+    0xEBE9EA2ADF4321C7ULL, 0x03219A39EE587A30ULL, 0x49787FEF17AF9924ULL, 0xA1E9300CD8520548ULL,
+    0x5B45E522E4B1B4EFULL, 0xB49C3B3995091A36ULL, 0xD4490AD526F14431ULL, 0x12A8F216AF9418C2ULL,
+    0x001F837CC7350524ULL, 0x1877B51E57A764D5ULL, 0xA2853B80F17F58EEULL, 0x993E1DE72D36D310ULL,
+    0xB3598080CE64A656ULL, 0x252F59CF0D9F04BBULL, 0xD23C8E176D113600ULL, 0x1BDA0492E7E4586EULL,
+    0x21E0BD5026C619BFULL, 0x3B097ADAF088F94EULL, 0x8D14DEDB30BE846EULL, 0xF95CFFA23AF5F6F4ULL,
+    0x3871700761B3F743ULL, 0xCA672B91E9E4FA16ULL, 0x64C8E531BFF53B55ULL, 0x241260ED4AD1E87DULL,
+    0x106C09B972D2E822ULL, 0x7FBA195410E5CA30ULL, 0x7884D9BC6CB569D8ULL, 0x0647DFEDCD894A29ULL,
+    0x63573FF03E224774ULL, 0x4FC8E9560F91B123ULL, 0x1DB956E450275779ULL, 0xB8D91274B9E9D4FBULL,
+    0xA2EBEE47E2FBFCE1ULL, 0xD9F1F30CCD97FB09ULL, 0xEFED53D75FD64E6BULL, 0x2E6D02C36017F67FULL,
+    0xA9AA4D20DB084E9BULL, 0xB64BE8D8B25396C1ULL, 0x70CB6AF7C2D5BCF0ULL, 0x98F076A4F7A2322EULL,
+    0xBF84470805E69B5FULL, 0x94C3251F06F90CF3ULL, 0x3E003E616A6591E9ULL, 0xB925A6CD0421AFF3ULL,
+    0x61BDD1307C66E300ULL, 0xBF8D5108E27E0D48ULL, 0x240AB57A8B888B20ULL, 0xFC87614BAF287E07ULL,
+    0xEF02CDD06FFDB432ULL, 0xA1082C0466DF6C0AULL, 0x8215E577001332C8ULL, 0xD39BB9C3A48DB6CFULL,
+    0x2738259634305C14ULL, 0x61CF4F94C97DF93DULL, 0x1B6BACA2AE4E125BULL, 0x758F450C88572E0BULL,
+    0x959F587D507A8359ULL, 0xB063E962E045F54DULL, 0x60E8ED72C0DFF5D1ULL, 0x7B64978555326F9FULL,
+    0xFD080D236DA814BAULL, 0x8C90FD9B083F4558ULL, 0x106F72FE81E2C590ULL, 0x7976033A39F7D952ULL,
+    0xA4EC0132764CA04BULL, 0x733EA705FAE4FA77ULL, 0xB4D8F77BC3E56167ULL, 0x9E21F4F903B33FD9ULL,
+    0x9D765E419FB69F6DULL, 0xD30C088BA61EA5EFULL, 0x5D94337FBFAF7F5BULL, 0x1A4E4822EB4D7A59ULL,
+    0x6FFE73E81B637FB3ULL, 0xDDF957BC36D8B9CAULL, 0x64D0E29EEA8838B3ULL, 0x08DD9BDFD96B9F63ULL,
+    0x087E79E5A57D1D13ULL, 0xE328E230E3E2B3FBULL, 0x1C2559E30F0946BEULL, 0x720BF5F26F4D2EAAULL,
+    0xB0774D261CC609DBULL, 0x443F64EC5A371195ULL, 0x4112CF68649A260EULL, 0xD813F2FAB7F5C5CAULL,
+    0x660D3257380841EEULL, 0x59AC2C7873F910A3ULL, 0xE846963877671A17ULL, 0x93B633ABFA3469F8ULL,
+    0xC0C0F5A60EF4CDCFULL, 0xCAF21ECD4377B28CULL, 0x57277707199B8175ULL, 0x506C11B9D90E8B1DULL,
+    0xD83CC2687A19255FULL, 0x4A29C6465A314CD1ULL, 0xED2DF21216235097ULL, 0xB5635C95FF7296E2ULL,
+    0x22AF003AB672E811ULL, 0x52E762596BF68235ULL, 0x9AEBA33AC6ECC6B0ULL, 0x944F6DE09134DFB6ULL,
+    0x6C47BEC883A7DE39ULL, 0x6AD047C430A12104ULL, 0xA5B1CFDBA0AB4067ULL, 0x7C45D833AFF07862ULL,
+    0x5092EF950A16DA0BULL, 0x9338E69C052B8E7BULL, 0x455A4B4CFE30E3F5ULL, 0x6B02E63195AD0CF8ULL,
+    0x6B17B224BAD6BF27ULL, 0xD1E0CCD25BB9C169ULL, 0xDE0C89A556B9AE70ULL, 0x50065E535A213CF6ULL,
+    0x9C1169FA2777B874ULL, 0x78EDEFD694AF1EEDULL, 0x6DC93D9526A50E68ULL, 0xEE97F453F06791EDULL,
+    0x32AB0EDB696703D3ULL, 0x3A6853C7E70757A7ULL, 0x31865CED6120F37DULL, 0x67FEF95D92607890ULL,
+    0x1F2B1D1F15F6DC9CULL, 0xB69E38A8965C6B65ULL, 0xAA9119FF184CCCF4ULL, 0xF43C732873F24C13ULL,
+    0xFB4A3D794A9A80D2ULL, 0x3550C2321FD6109CULL, 0x371F77E76BB8417EULL, 0x6BFA9AAE5EC05779ULL,
+    0xCD04F3FF001A4778ULL, 0xE3273522064480CAULL, 0x9F91508BFFCFC14AULL, 0x049A7F41061A9E60ULL,
+    0xFCB6BE43A9F2FE9BULL, 0x08DE8A1C7797DA9BULL, 0x8F9887E6078735A1ULL, 0xB5B4071DBFC73A66ULL,
+    0x230E343DFBA08D33ULL, 0x43ED7F5A0FAE657DULL, 0x3A88A0FBBCB05C63ULL, 0x21874B8B4D2DBC4FULL,
+    0x1BDEA12E35F6A8C9ULL, 0x53C065C6C8E63528ULL, 0xE34A1D250E7A8D6BULL, 0xD6B04D3B7651DD7EULL,
+    0x5E90277E7CB39E2DULL, 0x2C046F22062DC67DULL, 0xB10BB459132D0A26ULL, 0x3FA9DDFB67E2F199ULL,
+    0x0E09B88E1914F7AFULL, 0x10E8B35AF3EEAB37ULL, 0x9EEDECA8E272B933ULL, 0xD4C718BC4AE8AE5FULL,
+    0x81536D601170FC20ULL, 0x91B534F885818A06ULL, 0xEC8177F83F900978ULL, 0x190E714FADA5156EULL,
+    0xB592BF39B0364963ULL, 0x89C350C893AE7DC1ULL, 0xAC042E70F8B383F2ULL, 0xB49B52E587A1EE60ULL,
+    0xFB152FE3FF26DA89ULL, 0x3E666E6F69AE2C15ULL, 0x3B544EBE544C19F9ULL, 0xE805A1E290CF2456ULL,
+    0x24B33C9D7ED25117ULL, 0xE74733427B72F0C1ULL, 0x0A804D18B7097475ULL, 0x57E3306D881EDB4FULL,
+    0x4AE7D6A36EB5DBCBULL, 0x2D8D5432157064C8ULL, 0xD1E649DE1E7F268BULL, 0x8A328A1CEDFE552CULL,
+    0x07A3AEC79624C7DAULL, 0x84547DDC3E203C94ULL, 0x990A98FD5071D263ULL, 0x1A4FF12616EEFC89ULL,
+    0xF6F7FD1431714200ULL, 0x30C05B1BA332F41CULL, 0x8D2636B81555A786ULL, 0x46C9FEB55D120902ULL,
+    0xCCEC0A73B49C9921ULL, 0x4E9D2827355FC492ULL, 0x19EBB029435DCB0FULL, 0x4659D2B743848A2CULL,
+    0x963EF2C96B33BE31ULL, 0x74F85198B05A2E7DULL, 0x5A0F544DD2B1FB18ULL, 0x03727073C2E134B1ULL,
+    0xC7F6AA2DE59AEA61ULL, 0x352787BAA0D7C22FULL, 0x9853EAB63B5E0B35ULL, 0xABBDCDD7ED5C0860ULL,
+    0xCF05DAF5AC8D77B0ULL, 0x49CAD48CEBF4A71EULL, 0x7A4C10EC2158C4A6ULL, 0xD9E92AA246BF719EULL,
+    0x13AE978D09FE5557ULL, 0x730499AF921549FFULL, 0x4E4B705B92903BA4ULL, 0xFF577222C14F0A3AULL,
+    0x55B6344CF97AAFAEULL, 0xB862225B055B6960ULL, 0xCAC09AFBDDD2CDB4ULL, 0xDAF8E9829FE96B5FULL,
+    0xB5FDFC5D3132C498ULL, 0x310CB380DB6F7503ULL, 0xE87FBB46217A360EULL, 0x2102AE466EBB1148ULL,
+    0xF8549E1A3AA5E00DULL, 0x07A69AFDCC42261AULL, 0xC4C118BFE78FEAAEULL, 0xF9F4892ED96BD438ULL,
+    0x1AF3DBE25D8F45DAULL, 0xF5B4B0B0D2DEEEB4ULL, 0x962ACEEFA82E1C84ULL, 0x046E3ECAAF453CE9ULL,
+    0xF05D129681949A4CULL, 0x964781CE734B3C84ULL, 0x9C2ED44081CE5FBDULL, 0x522E23F3925E319EULL,
+    0x177E00F9FC32F791ULL, 0x2BC60A63A6F3B3F2ULL, 0x222BBFAE61725606ULL, 0x486289DDCC3D6780ULL,
+    0x7DC7785B8EFDFC80ULL, 0x8AF38731C02BA980ULL, 0x1FAB64EA29A2DDF7ULL, 0xE4D9429322CD065AULL,
+    0x9DA058C67844F20CULL, 0x24C0E332B70019B0ULL, 0x233003B5A6CFE6ADULL, 0xD586BD01C5C217F6ULL,
+    0x5E5637885F29BC2BULL, 0x7EBA726D8C94094BULL, 0x0A56A5F0BFE39272ULL, 0xD79476A84EE20D06ULL,
+    0x9E4C1269BAA4BF37ULL, 0x17EFEE45B0DEE640ULL, 0x1D95B0A5FCF90BC6ULL, 0x93CBE0B699C2585DULL,
+    0x65FA4F227A2B6D79ULL, 0xD5F9E858292504D5ULL, 0xC2B5A03F71471A6FULL, 0x59300222B4561E00ULL,
+    0xCE2F8642CA0712DCULL, 0x7CA9723FBB2E8988ULL, 0x2785338347F2BA08ULL, 0xC61BB3A141E50E8CULL,
+    0x150F361DAB9DEC26ULL, 0x9F6A419D382595F4ULL, 0x64A53DC924FE7AC9ULL, 0x142DE49FFF7A7C3DULL,
+    0x0C335248857FA9E7ULL, 0x0A9C32D5EAE45305ULL, 0xE6C42178C4BBB92EULL, 0x71F1CE2490D20B07ULL,
+    0xF1BCC3D275AFE51AULL, 0xE728E8C83C334074ULL, 0x96FBF83A12884624ULL, 0x81A1549FD6573DA5ULL,
+    0x5FA7867CAF35E149ULL, 0x56986E2EF3ED091BULL, 0x917F1DD5F8886C61ULL, 0xD20D8C88C8FFE65FULL,
+    // Castling rights: white short, white long, black short, black long
+    0x31D71DCE64B2C310ULL, 0xF165B587DF898190ULL, 0xA57E6339DD2CF3A0ULL, 0x1EF6E6DBB1961EC9ULL,
+    // En passant file
+    0x70CC73D90BC26E24ULL, 0xE21A6B35DF0C3AD7ULL, 0x003A93D8B2806962ULL, 0x1C99DED33CB890A1ULL,
+    0xCF3145DE0ADD4289ULL, 0xD0E4427A5514FB72ULL, 0x77C621CC9FB3A483ULL, 0x67A34DAC4356550BULL,
+    // White to move
+    0xF8D626AAAF278509ULL
+};
+
+#define POLYGLOT_CASTLING 768
+#define POLYGLOT_EN_PASSANT 772
+#define POLYGLOT_TURN 780
+#define BOOK_ENTRY_SIZE 16
+
+typedef struct {
+    const uint8_t *entries; // Mapped file, num_entries entries of BOOK_ENTRY_SIZE bytes
+    uint64_t num_entries;
+    size_t mapping_size;
+} Book;
+
+uint64_t polyglot_key(const Board *board){
+    uint64_t key = 0;
+    for(int sq=0; sq<64; sq++){
+        int peice = board->squares[sq];
+        if(peice == EMPTY) continue;
+        int kind = 2 * (PEICE_TYPE(peice) - 1) + (PEICE_COLOR(peice) == 0);
+        key ^= POLYGLOT_RANDOM[64 * kind + sq];
+    }
+    for(int i=0; i<4; i++){
+        if(board->castling_rights & (1 << i)) key ^= POLYGLOT_RANDOM[POLYGLOT_CASTLING + i];
+    }
+    // The en passant file only counts when a pawn can actually take there
+    if(board->en_passant >= 0){
+        int us = COLOR_INDEX(board->to_move);
+        int pawn = us == 0 ? W_PAWN : B_PAWN;
+        if(pawn_attacks[us ^ 1][board->en_passant] & board->peice_bb[pawn]){
+            key ^= POLYGLOT_RANDOM[POLYGLOT_EN_PASSANT + board->en_passant % 8];
+        }
+    }
+    if(board->to_move == 1) key ^= POLYGLOT_RANDOM[POLYGLOT_TURN];
+    return key;
+}
+
+static inline uint64_t read_big_endian(const uint8_t *bytes, int size){
+    uint64_t value = 0;
+    for(int i=0; i<size; i++) value = (value << 8) | bytes[i];
+    return value;
+}
+
+void book_unload(Book *book){
+    if(book->entries) munmap((void *)book->entries, book->mapping_size);
+    memset(book, 0, sizeof(Book));
+}
+
+// Maps a book file, like network_load(). Returns 1 on success, 0 (leaving book empty) if it cannot be read
+int book_load(Book *book, const char *path){
+    book_unload(book);
+
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return 0;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < BOOK_ENTRY_SIZE || st.st_size % BOOK_ENTRY_SIZE != 0){
+        close(fd);
+        return 0;
+    }
+    void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED) return 0;
+
+    book->entries = (const uint8_t *)mapping;
+    book->num_entries = st.st_size / BOOK_ENTRY_SIZE;
+    book->mapping_size = st.st_size;
+    return 1;
+}
+
+// Looks board up in the book and picks one of its legal moves there, the heaviest when best is set and otherwise
+// at random in proportion to the weights. Returns 0 if the position is not in the book or has no playable move
+int book_probe(const Book *book, Board *board, bool best, uint64_t *seed, Move *move){
+    if(book->entries == NULL) return 0;
+    uint64_t key = polyglot_key(board);
+
+    // First entry with this key
+    uint64_t low = 0, high = book->num_entries;
+    while(low < high){
+        uint64_t middle = (low + high) / 2;
+        if(read_big_endian(book->entries + middle * BOOK_ENTRY_SIZE, 8) < key) low = middle + 1;
+        else high = middle;
+    }
+
+    Move legal[MAX_MOVES];
+    int num_legal = generate_moves(board, legal, GEN_ALL);
+    int chosen = -1;
+    uint64_t chosen_weight = 0, total_weight = 0;
+    for(uint64_t i=low; i<book->num_entries; i++){
+        const uint8_t *entry = book->entries + i * BOOK_ENTRY_SIZE;
+        if(read_big_endian(entry, 8) != key) break;
+        int encoded = (int)read_big_endian(entry + 8, 2);
+        uint64_t weight = read_big_endian(entry + 10, 2);
+        if(weight == 0) continue;
+
+        // Castling is stored as the king taking its own rook
+        int to = encoded & 0x3F, from = (encoded >> 6) & 0x3F, promotion = (encoded >> 12) & 0x7;
+        if(PEICE_TYPE(board->squares[from]) == W_KING && (from == 4 || from == 60)){
+            if(to == from + 3) to = from + 2;
+            else if(to == from - 4) to = from - 2;
+        }
+
+        for(int j=0; j<num_legal; j++){
+            Move candidate = legal[j];
+            int candidate_promotion = move_kind(candidate) == MOVE_PROMOTION ? promotion_type(candidate) - 1 : 0;
+            if(move_from(candidate) != from || move_to(candidate) != to || candidate_promotion != promotion) continue;
+            total_weight += weight;
+            // Reservoir sampling keeps each move with probability weight / total_weight
+            if(best ? weight > chosen_weight : magic_rand(seed) % total_weight < weight){
+                chosen = j;
+                chosen_weight = weight;
+            }
+            break;
+        }
+    }
+    if(chosen < 0) return 0;
+    *move = legal[chosen];
+    return 1;
+}
+
+// --------------------- //
+
+// Positions and result arrays of one engine_search_batch call, read by every worker
+typedef struct {
+    int count;
+    const char *boards; // Python Boards, PYTHON_BOARD_SIZE bytes apart
+    const char *const *fens; // Used when boards is NULL
+    const double *time_limits; // Seconds per position, NULL or 0 for none
+    const uint64_t *node_limits; // Nodes per position, NULL or 0 for none
+    char (*moves)[6];
+    int *scores;
+    int *evals;
+    std::atomic<int> next; // Next position to be taken by a worker
+} BatchJob;
+
+// An engine owns everything that outlives one search: the transposition table, the network, one search
+// context per thread (history and pawn tables carry over between moves), the parked helper threads and
+// the buffer the move is returned in. Engines share nothing, so one process can run several at once.
+struct Engine {
+    TranspositionTable tt;
+    Network network; // Nothing mapped means the piece square evaluation
+    SearchOptions options;
+    int num_threads;
+    SearchContext *contexts; // One per thread, [0] is searched by the calling thread
+    SharedSearch shared;
+    Board position; // Root of the last search, engine_search plays its moves from here
+    std::thread *helpers; // num_threads - 1 threads waiting in helper_loop between searches
+    std::mutex lock;
+    std::condition_variable wake; // Signalled when search_id changes or quit is set
+    std::condition_variable done; // Signalled when the last helper finishes its search
+    void (*job)(Engine *engine, int thread_id); // What the helpers run when woken
+    BatchJob *batch; // Set during engine_search_batch
+    uint64_t search_id; // Bumped to start the helpers on a new job
+    int helpers_running;
+    bool quit;
+    char output[6]; // UCI move of the last search
+    SearchStats stats; // Of the last search, set by finish_search
+    char stats_json[8192];
+
+    // Opening book, probed before every search when loaded
+    Book book;
+    bool use_book; // engine_set_option("book", 0) searches book positions too
+    bool book_best; // Always the heaviest book move instead of a weighted random one
+    uint64_t book_seed;
+
+    // Pondering: after answering, the threads search the position after our move and the expected reply
+    bool ponder; // Switched with engine_set_option("ponder", 1)
+    bool pondering; // ponder_thread runs (or ran and has to be joined)
+    bool ponder_finished; // The ponder search stopped by itself, guarded by lock
+    std::thread ponder_thread; // Plays the part of the calling thread for the ponder search
+    Board ponder_position;
+};
+
+// Quiescence search: only captures and queen promotions that do not lose material by SEE, until the position is quiet
+// The side to move may stand pat on the static evaluation, except in check where every evasion is searched
+int quiescence(SearchContext *ctx, Board *board, int alpha, int beta, int ply){
+    count_node(ctx);
+    STAT(ctx->stats.qnodes++);
+    STAT(if(ply > ctx->stats.seldepth) ctx->stats.seldepth = ply);
+    bool pv_node = beta - alpha > 1;
+    bool checked = board->checkers != 0;
+
+    if(ply >= MAX_PLY - 1 || out_of_time(ctx)){
+        return evaluate_board(board, ctx->pawn_table);
+    }
+
+    TTHit hit;
+    bool tt_hit = tt_probe(&ctx->engine->tt, board->hash, &hit);
+    STAT(ctx->stats.tt_probes++, ctx->stats.tt_hits += tt_hit);
+    if(tt_hit) hit.score = score_from_tt(hit.score, ply);
+    if(tt_hit && !pv_node){
+        if(hit.bound == BOUND_EXACT
+            || (hit.bound == BOUND_LOWER && hit.score >= beta)
+            || (hit.bound == BOUND_UPPER && hit.score <= alpha)){
+            return hit.score;
+        }
+    }
+
+    int original_alpha = alpha;
+    int best_score = -INFINITY;
+    int stand_pat = -INFINITY;
+    if(!checked){
+        stand_pat = best_score = evaluate_board(board, ctx->pawn_table);
+        if(stand_pat >= beta){
+            return stand_pat;
+        }
+        if(stand_pat > alpha){
+            alpha = stand_pat;
+        }
+    }
+
+    MovePicker mp;
+    init_move_picker(&mp, board, ctx, tt_hit ? hit.move : MOVE_NONE, ply, !checked);
+
+    Move move;
+    Move best_move = MOVE_NONE;
+    int num_moves = 0;
+    while(next_move(&mp, &move)){
+        num_moves++;
+        if(!checked){
+            // Underpromotions are never better than the queen
+            if(move_kind(move) == MOVE_PROMOTION && promotion_type(move) != W_QUEEN) continue;
+
+            // Delta pruning: even winning the captured peice for free leaves us below alpha
+            if(move_kind(move) != MOVE_PROMOTION
+                && stand_pat + PEICE_VALUES[PEICE_TYPE(captured_peice(board, move))] + DELTA_MARGIN <= alpha) continue;
+        }
+
+        apply_move(board, move, &ctx->states[ply]);
+        int score = -quiescence(ctx, board, -beta, -alpha, ply + 1);
+        undo_move(board, move, &ctx->states[ply]);
+
+        if(out_of_time(ctx)){
+            return 0;
+        }
+
+        if(score > best_score){
+            best_score = score;
+            if(score > alpha){
+                best_move = move;
+                if(score >= beta) break;
+                alpha = score;
+            }
+        }
+    }
+
+    if(checked && num_moves == 0){
+        return -(MATE_SCORE - ply);
+    }
+
+    int bound = best_score >= beta ? BOUND_LOWER : best_score > original_alpha ? BOUND_EXACT : BOUND_UPPER;
+    tt_store(&ctx->engine->tt, board->hash, 0, score_to_tt(best_score, ply), bound, best_move);
+    return best_score;
+}
+
+// Negamax principal variation search with alpha beta pruning, scores are from the side to move's view
+// Every move after the first is searched with a zero window and only searched again if it beats alpha
+int negamax(SearchContext *ctx, Board *board, int depth, int alpha, int beta, int ply){
+    count_node(ctx);
+    STAT(if(ply > ctx->stats.seldepth) ctx->stats.seldepth = ply);
+    bool pv_node = beta - alpha > 1;
+
+    //Leaf Node of game tree, captures are resolved before the position is evaluated
+    if(depth <= 0){
+        return quiescence(ctx, board, alpha, beta, ply);
+    }
+    if(ply >= MAX_PLY - 1 || out_of_time(ctx)){
+        return evaluate_board(board, ctx->pawn_table);
+    }
+
+    // A bitbase draw is final. Wins are still searched, the bitbase score only guides the search to the mate
+    int known;
+    if(bitbase_evaluate(board, &known) && known == 0){
+        return 0;
+    }
+
+    // Table cutoffs are left out of PV nodes so the principal variation is always searched
+    TTHit hit;
+    bool tt_hit = tt_probe(&ctx->engine->tt, board->hash, &hit);
+    STAT(ctx->stats.tt_probes++, ctx->stats.tt_hits += tt_hit);
+    if(tt_hit) hit.score = score_from_tt(hit.score, ply);
+    if(tt_hit && !pv_node && hit.depth >= depth){
+        if(hit.bound == BOUND_EXACT
+            || (hit.bound == BOUND_LOWER && hit.score >= beta)
+            || (hit.bound == BOUND_UPPER && hit.score <= alpha)){
+            return hit.score;
+        }
+    }
+
+    bool checked = board->checkers != 0;
+    int static_eval = checked ? -INFINITY : evaluate_board(board, ctx->pawn_table);
+    bool mate_window = beta >= MATE_SCORE - MAX_PLY || alpha <= -MATE_SCORE + MAX_PLY;
+
+    if(!pv_node && !checked && !mate_window){
+        // Reverse futility: the static evaluation beats beta by more than the opponent can recover near the leaves
+        if(ctx->engine->options.reverse_futility && depth <= 6 && static_eval - REVERSE_FUTILITY_MARGIN * depth >= beta){
+            return static_eval;
+        }
+
+        // Razoring: hopeless by a wide margin, check with quiescence that no capture saves it
+        if(ctx->engine->options.razoring && depth <= 2 && static_eval + RAZOR_MARGIN * depth < alpha){
+            int score = quiescence(ctx, board, alpha - 1, alpha, ply);
+            if(score < alpha){
+                return score;
+            }
+        }
+
+        // Null move: if passing still fails high, a real move surely would. Skipped right after another
+        // null move and without peices to move, where zugzwang makes passing the better option
+        if(ctx->engine->options.null_move && depth >= 3 && static_eval >= beta && !ctx->null_move[ply - 1] && has_non_pawn_material(board)){
+            int reduction = 3 + depth / 4;
+            apply_null_move(board, &ctx->states[ply]);
+            ctx->null_move[ply] = true;
+            int score = -negamax(ctx, board, depth - 1 - reduction, -beta, -beta + 1, ply + 1);
+            ctx->null_move[ply] = false;
+            undo_null_move(board, &ctx->states[ply]);
+
+            if(out_of_time(ctx)){
+                return 0;
+            }
+            if(score >= beta){
+                return score >= MATE_SCORE - MAX_PLY ? beta : score; // A mate found by passing is not proven
+            }
+        }
+    }
+
+    // Futility: near the leaves a quiet move cannot lift a position this far below alpha
+    bool futile = ctx->engine->options.futility && !pv_node && !checked && !mate_window && depth <= 3
+               && static_eval + FUTILITY_BASE + FUTILITY_MARGIN * depth <= alpha;
+
+    MovePicker mp;
+    init_move_picker(&mp, board, ctx, tt_hit ? hit.move : MOVE_NONE, ply, false);
+
+    Move move;
+    Move best_move = MOVE_NONE;
+    Move quiets[64]; // Quiet moves searched without a cutoff, punished in the history on a later cutoff
+    int num_quiets = 0;
+    int num_moves = 0;
+    int original_alpha = alpha;
+    int best_score = -INFINITY;
+
+    while(next_move(&mp, &move)){
+        num_moves++;
+        bool quiet = !is_tactical(board, move);
+        apply_move(board, move, &ctx->states[ply]);
+        bool gives_check = board->checkers != 0;
+
+        if(futile && quiet && !gives_check && num_moves > 1){
+            undo_move(board, move, &ctx->states[ply]);
+            continue;
+        }
+
+        int score;
+        if(num_moves == 1){
+            score = -negamax(ctx, board, depth - 1, -beta, -alpha, ply + 1);
+        }
+        else{
+            // Late move reductions: quiet moves this far down the ordered list rarely matter,
+            // so search them shallower first and at full depth only if they beat alpha anyway
+            int reduction = 0;
+            if(ctx->engine->options.late_move_reductions && depth >= 3 && quiet && !checked && !gives_check
+                && num_moves > (pv_node ? 3 : 2)){
+                reduction = reductions[depth < 64 ? depth : 63][num_moves < 64 ? num_moves : 63];
+                if(pv_node) reduction--;
+                if(is_killer(&mp, move)) reduction--;
+                if(reduction > depth - 2) reduction = depth - 2;
+                if(reduction < 0) reduction = 0;
+            }
+
+            score = -negamax(ctx, board, depth - 1 - reduction, -alpha - 1, -alpha, ply + 1);
+            if(reduction > 0 && score > alpha){
+                score = -negamax(ctx, board, depth - 1, -alpha - 1, -alpha, ply + 1);
+            }
+            if(score > alpha && score < beta){
+                score = -negamax(ctx, board, depth - 1, -beta, -alpha, ply + 1);
+            }
+        }
+        undo_move(board, move, &ctx->states[ply]);
+
+        // Whatever was found after the stop is incomplete, the caller throws it away
+        if(out_of_time(ctx)){
+            return 0;
+        }
+
+        if(score > best_score){
+            best_score = score;
+            if(score > alpha){
+                best_move = move;
+                if(score >= beta){
+                    // Beta Cutoff
+                    STAT(ctx->stats.cutoffs++, ctx->stats.first_move_cutoffs += num_moves == 1);
+                    STAT(ctx->stats.stage_cutoffs[cutoff_stage(&mp)]++);
+                    if(quiet){
+                        update_quiet_heuristics(ctx, board, move, ply, depth, quiets, num_quiets);
+                    }
+                    break;
+                }
+                alpha = score;
+            }
+        }
+        if(quiet && num_quiets < 64){
+            quiets[num_quiets++] = move;
+        }
+    }
+
+    if(num_moves == 0){
+        //Check mate or stale mate
+        return board->checkers ? -(MATE_SCORE - ply) : 0;
+    }
+
+    int bound = best_score >= beta ? BOUND_LOWER : best_score > original_alpha ? BOUND_EXACT : BOUND_UPPER;
+    tt_store(&ctx->engine->tt, board->hash, depth, score_to_tt(best_score, ply), bound, best_move);
+    return best_score;
+}
+
+// Searches every root move to depth with the (alpha, beta) window, returns the best score
+// Moves that did not raise alpha get -INFINITY, so sorting by score afterwards puts the best first
+// and leaves the others in the order of the previous iteration
+static int search_root(SearchContext *ctx, RootMove *root_moves, int num_moves, int depth, int alpha, int beta){
+    Board *board = &ctx->board;
+    int best_score = -INFINITY;
+
+    for(int i=0; i<num_moves; i++){
+        root_moves[i].score = -INFINITY;
+    }
+
+    for(int i=0; i<num_moves; i++){
+        Move move = root_moves[i].move;
+        apply_move(board, move, &ctx->states[0]);
+        int score;
+        if(i == 0){
+            score = -negamax(ctx, board, depth - 1, -beta, -alpha, 1);
+        }
+        else{
+            score = -negamax(ctx, board, depth - 1, -alpha - 1, -alpha, 1);
+            if(score > alpha && score < beta){
+                score = -negamax(ctx, board, depth - 1, -beta, -alpha, 1);
+            }
+        }
+        undo_move(board, move, &ctx->states[0]);
+
+        if(out_of_time(ctx)){
+            break;
+        }
+
+        if(i == 0 || score > alpha){
+            root_moves[i].score = score;
+        }
+        if(score > best_score){
+            best_score = score;
+            if(i > 0 && score > alpha){
+                ctx->best_move_changes++;
+            }
+            if(score > alpha){
+                alpha = score;
+                if(score >= beta) break;
+            }
+        }
+    }
+    return best_score;
+}
+
+// Stable insertion sort, the root list is short and mostly sorted already
+static void sort_root_moves(RootMove *root_moves, int num_moves){
+    for(int i=1; i<num_moves; i++){
+        RootMove key = root_moves[i];
+        int j = i - 1;
+        while(j >= 0 && root_moves[j].score < key.score){
+            root_moves[j + 1] = root_moves[j];
+            j--;
+        }
+        root_moves[j + 1] = key;
+    }
+}
+
+// Lazy SMP depth staggering: helper thread i skips the depths where ((depth + SKIP_PHASE) / SKIP_SIZE) is odd,
+// so the helpers spread over neighbouring depths and fill the shared table for the main thread
+static const int SKIP_SIZE[20] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+static const int SKIP_PHASE[20] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+// Iterative deepening over the root moves of ctx->board, run by every search thread
+// Each depth starts with an aspiration window around the previous score, and only a depth that
+// completes replaces the result, so running out of time never throws away a deeper answer
+void iterative_deepening(SearchContext *ctx){
+    Board *board = &ctx->board;
+
+    // Initial root order from the move picker: table move, captures, then quiet moves
+    RootMove root_moves[MAX_MOVES];
+    int num_moves = 0;
+    TTHit hit;
+    MovePicker mp;
+    init_move_picker(&mp, board, ctx, tt_probe(&ctx->engine->tt, board->hash, &hit) ? hit.move : MOVE_NONE, 0, false);
+    Move move;
+    while(next_move(&mp, &move)){
+        root_moves[num_moves].move = move;
+        root_moves[num_moves].score = -INFINITY;
+        num_moves++;
+    }
+
+    ctx->best_move = root_moves[0].move;
+    ctx->best_score = -INFINITY;
+    ctx->completed_depth = 0;
+
+    for(int depth = 1; depth <= ctx->shared->tm.depth_limit; depth++){
+        if(out_of_time(ctx)){
+            break;
+        }
+
+        int helper = (ctx->thread_id - 1) % 20;
+        if(ctx->thread_id > 0 && ((depth + SKIP_PHASE[helper]) / SKIP_SIZE[helper]) % 2){
+            continue;
+        }
+
+        TimePoint iteration_start = std::chrono::steady_clock::now();
+        ctx->best_move_changes = 0;
+
+        // Aspiration window, widened on the failing side until the score falls inside it
+        int delta = ASPIRATION_WINDOW;
+        int alpha = -INFINITY, beta = INFINITY;
+        if(depth >= 4 && ctx->completed_depth > 0){
+            alpha = ctx->best_score - delta > -INFINITY ? ctx->best_score - delta : -INFINITY;
+            beta = ctx->best_score + delta < INFINITY ? ctx->best_score + delta : INFINITY;
+        }
+
+        int score;
+        while(true){
+            score = search_root(ctx, root_moves, num_moves, depth, alpha, beta);
+            sort_root_moves(root_moves, num_moves);
+            if(out_of_time(ctx)){
+                break;
+            }
+
+            if(score <= alpha){
+                beta = (alpha + beta) / 2;
+                alpha = score - delta > -INFINITY ? score - delta : -INFINITY;
+            }
+            else if(score >= beta){
+                beta = score + delta < INFINITY ? score + delta : INFINITY;
+            }
+            else{
+                break;
+            }
+            delta *= 2;
+        }
+
+        if(out_of_time(ctx)){
+            break;
+        }
+
+        ctx->completed_depth = depth;
+        ctx->best_move = root_moves[0].move;
+        ctx->best_score = score;
+        ctx->stats.depth_time[depth] = seconds_since(ctx->shared->tm.start);
+        tt_store(&ctx->engine->tt, board->hash, depth, score_to_tt(score, 0), BOUND_EXACT, ctx->best_move);
+
+        // Only the main thread decides whether another iteration fits in the budget
+        if(ctx->thread_id == 0){
+            if(num_moves == 1 || time_manager_stop(&ctx->shared->tm, seconds_since(iteration_start), ctx->best_move_changes)){
+                break;
+            }
+        }
+    }
+
+    // The helpers have nothing left to do once the main thread is finished
+    if(ctx->thread_id == 0){
+        ctx->shared->stop.store(true);
+    }
+}
+
+// ------- Positions ---------- //
+
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+// Sets board from a FEN string, returns 0 and leaves board unusable if the string is malformed
+// The halfmove and fullmove counters may be left out
+int board_from_fen(Board *board, const char *fen){
+    memset(board, 0, sizeof(Board));
+    const char *symbols = " PNBRQKpnbrqk";
+    int rank = 7, file = 0;
+    for(; *fen && *fen != ' '; fen++){
+        if(*fen == '/'){
+            if(file != 8 || rank == 0) return 0;
+            rank--;
+            file = 0;
+        }
+        else if(*fen >= '1' && *fen <= '8'){
+            file += *fen - '0';
+        }
+        else{
+            const char *symbol = strchr(symbols, *fen);
+            if(symbol == NULL || file > 7) return 0;
+            board->squares[rank * 8 + file++] = (int)(symbol - symbols);
+        }
+        if(file > 8) return 0;
+    }
+    if(rank != 0 || file != 8 || *fen++ != ' ') return 0;
+
+    if(*fen != 'w' && *fen != 'b') return 0;
+    board->to_move = (*fen++ == 'w') ? 1 : -1;
+    if(*fen++ != ' ') return 0;
+
+    for(; *fen && *fen != ' '; fen++){
+        if(*fen == 'K') board->castling_rights |= 0x1;
+        else if(*fen == 'Q') board->castling_rights |= 0x2;
+        else if(*fen == 'k') board->castling_rights |= 0x4;
+        else if(*fen == 'q') board->castling_rights |= 0x8;
+        else if(*fen != '-') return 0;
+    }
+    if(*fen++ != ' ') return 0;
+
+    board->en_passant = -1;
+    if(fen[0] >= 'a' && fen[0] <= 'h' && (fen[1] == '3' || fen[1] == '6')){
+        board->en_passant = (fen[1] - '1') * 8 + (fen[0] - 'a');
+        fen += 2;
+    }
+    else if(*fen++ != '-') return 0;
+
+    board->fullmove_number = 1;
+    if(sscanf(fen, " %d %d", &board->halfmove_clock, &board->fullmove_number) < 2) board->fullmove_number = 1;
+
+    // Exactly one king each, and the side that just moved may not be in check
+    for(int king=W_KING; king<=B_KING; king+=B_KING - W_KING){
+        int count = 0;
+        for(int sq=0; sq<64; sq++) count += board->squares[sq] == king;
+        if(count != 1) return 0;
+    }
+    init_board_state(board);
+    return !in_check(board, -board->to_move);
+}
+
+// Writes move in UCI notation (e2e4, e7e8q) to out, which holds at least 6 chars
+void move_to_uci(Move move, char *out){
+    int from = move_from(move), to = move_to(move);
+    out[0] = 'a' + (from%8);
+    out[1] = '1' + (from/8);
+    out[2] = 'a' + (to%8);
+    out[3] = '1' + (to/8);
+    out[4] = '\0';
+
+    //Added promtion
+    if(move_kind(move) == MOVE_PROMOTION){
+        char promotion_value;
+        switch(promotion_type(move)){
+            case W_KNIGHT:
+                promotion_value = 'n';
+                break;
+            case W_BISHOP:
+                promotion_value = 'b';
+                break;
+            case W_ROOK:
+                promotion_value = 'r';
+                break;
+            default:
+                promotion_value = 'q';
+        }
+        out[4] = promotion_value;
+        out[5] = '\0';
+    }
+}
+
+// Plays a space separated list of UCI moves on board, returns 0 at the first one that is not legal
+int apply_uci_moves(Board *board, const char *moves){
+    char token[8];
+    int length;
+    while(sscanf(moves, " %7s%n", token, &length) == 1){
+        moves += length;
+        Move legal[MAX_MOVES];
+        int num_moves = generate_moves(board, legal, GEN_ALL);
+        int found = -1;
+        for(int i=0; i<num_moves && found < 0; i++){
+            char uci[6];
+            move_to_uci(legal[i], uci);
+            if(!strcmp(uci, token)) found = i;
+        }
+        if(found < 0) return 0;
+        StateInfo state; // Not taken back
+        apply_move(board, legal[found], &state);
+    }
+    return 1;
+}
+
+// --------------------- //
+
+// ------- Engine ---------- //
+// Creating, running and destroying engines (struct Engine is defined before the search)
+
+static void helper_loop(Engine *engine, int index, uint64_t seen){
+    while(true){
+        {
+            std::unique_lock<std::mutex> guard(engine->lock);
+            while(!engine->quit && engine->search_id == seen) engine->wake.wait(guard);
+            if(engine->quit) return;
+            seen = engine->search_id;
+        }
+        engine->job(engine, index);
+
+        std::lock_guard<std::mutex> guard(engine->lock);
+        if(--engine->helpers_running == 0) engine->done.notify_all(); // The caller may be waiting on a ponder search too
+    }
+}
+
+static void start_threads(Engine *engine, int threads){
+    engine->num_threads = threads < 1 ? 1 : threads;
+    engine->contexts = (SearchContext *)calloc(engine->num_threads, sizeof(SearchContext));
+    engine->helpers = new std::thread[engine->num_threads - 1];
+    for(int i=1; i<engine->num_threads; i++){
+        engine->helpers[i - 1] = std::thread(helper_loop, engine, i, engine->search_id);
+    }
+}
+
+static void stop_threads(Engine *engine){
+    {
+        std::lock_guard<std::mutex> guard(engine->lock);
+        engine->quit = true;
+    }
+    engine->wake.notify_all();
+    for(int i=1; i<engine->num_threads; i++){
+        engine->helpers[i - 1].join();
+    }
+    delete[] engine->helpers;
+    free(engine->contexts);
+    engine->helpers = NULL;
+    engine->contexts = NULL;
+    engine->quit = false;
+}
+
+// Creates an engine, config may be NULL for the defaults. Returns NULL if the eval file cannot be loaded
+Engine *engine_create(const EngineConfig *config){
+    Engine *engine = new Engine();
+    engine->options = (SearchOptions){1, 1, 1, 1, 1};
+    engine->use_book = true;
+    engine->book_seed = (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count() | 1;
+    if(config && config->eval_file && config->eval_file[0] && !network_load(&engine->network, config->eval_file)){
+        delete engine;
+        return NULL;
+    }
+    tt_resize(&engine->tt, (config && config->hash_mb > 0) ? config->hash_mb : DEFAULT_HASH_MB);
+    start_threads(engine, config ? config->threads : 1);
+    engine_new_game(engine);
+    return engine;
+}
+
+void engine_destroy(Engine *engine){
+    if(engine == NULL) return;
+    engine_ponder_stop(engine);
+    stop_threads(engine);
+    free(engine->tt.buckets);
+    network_unload(&engine->network);
+    book_unload(&engine->book);
+    delete engine;
+}
+
+// Forgets everything learned in the previous game and goes back to the start position
+void engine_new_game(Engine *engine){
+    engine_ponder_stop(engine);
+    tt_clear(&engine->tt);
+    memset((void *)engine->contexts, 0, engine->num_threads * sizeof(SearchContext));
+    board_from_fen(&engine->position, START_FEN);
+}
+
+// Turns one selective search technique on (1) or off (0), returns 0 if the name is unknown
+// Names: null_move, late_move_reductions, reverse_futility, futility, razoring, and ponder, book and book_best for the engine
+int engine_set_option(Engine *engine, const char *name, int value){
+    SearchOptions *options = &engine->options;
+    if(!strcmp(name, "null_move")) options->null_move = value;
+    else if(!strcmp(name, "late_move_reductions")) options->late_move_reductions = value;
+    else if(!strcmp(name, "reverse_futility")) options->reverse_futility = value;
+    else if(!strcmp(name, "futility")) options->futility = value;
+    else if(!strcmp(name, "razoring")) options->razoring = value;
+    else if(!strcmp(name, "ponder")) engine->ponder = value;
+    else if(!strcmp(name, "book")) engine->use_book = value;
+    else if(!strcmp(name, "book_best")) engine->book_best = value;
+    else return 0;
+    return 1;
+}
+
+// Maps a Polyglot opening book, see book_load(). An empty path or NULL unloads it
+int engine_set_book(Engine *engine, const char *path){
+    book_unload(&engine->book);
+    if(path == NULL || path[0] == '\0') return 1;
+    return book_load(&engine->book, path);
+}
+
+// Statistics of the last engine_search or engine_search_board (batches are not recorded)
+void engine_get_stats(Engine *engine, SearchStats *stats){
+    *stats = engine->stats;
+}
+
+// The same as JSON, valid until the next call
+const char *engine_stats_json(Engine *engine){
+    SearchStats *stats = &engine->stats;
+    char *out = engine->stats_json;
+    size_t size = sizeof(engine->stats_json);
+    int length = snprintf(out, size,
+        "{\"nodes\":%llu,\"qnodes\":%llu,\"tt_probes\":%llu,\"tt_hits\":%llu,\"cutoffs\":%llu,\"first_move_cutoffs\":%llu,"
+        "\"stage_cutoffs\":{\"tt_move\":%llu,\"good_captures\":%llu,\"killers\":%llu,\"quiets\":%llu,\"bad_captures\":%llu},"
+        "\"depth\":%d,\"seldepth\":%d,\"score\":%d,\"time\":%.4f,\"nps\":%.0f,\"pv\":\"%s\",\"depth_time\":[",
+        (unsigned long long)stats->nodes, (unsigned long long)stats->qnodes, (unsigned long long)stats->tt_probes,
+        (unsigned long long)stats->tt_hits, (unsigned long long)stats->cutoffs, (unsigned long long)stats->first_move_cutoffs,
+        (unsigned long long)stats->stage_cutoffs[0], (unsigned long long)stats->stage_cutoffs[1], (unsigned long long)stats->stage_cutoffs[2],
+        (unsigned long long)stats->stage_cutoffs[3], (unsigned long long)stats->stage_cutoffs[4],
+        stats->depth, stats->seldepth, stats->score, stats->time, stats->time > 0 ? stats->nodes / stats->time : 0.0, stats->pv);
+    // depth_time[0] is unused, entry i of the array is depth i + 1
+    for(int depth=1; depth<=stats->depth && length < (int)size; depth++){
+        length += snprintf(out + length, size - length, depth > 1 ? ",%.4f" : "%.4f", stats->depth_time[depth]);
+    }
+    if(length < (int)size) snprintf(out + length, size - length, "]}");
+    return out;
+}
+
+// Readies a context for a search of root, keeping what carries over between moves
+static void prepare_context(Engine *engine, SearchContext *ctx, int thread_id, SharedSearch *shared, Board *root){
+    ctx->board = *root;
+    if(engine->network.mapping) nnue_attach(&ctx->board, ctx->accumulators, &engine->network);
+    ctx->thread_id = thread_id;
+    ctx->engine = engine;
+    ctx->shared = shared;
+    ctx->nodes = 0;
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    memset(ctx->killers, 0, sizeof(ctx->killers));
+    memset(ctx->null_move, 0, sizeof(ctx->null_move));
+
+    // Halved so the new position's cutoffs soon outweigh those of the last one
+    int *history = &ctx->history[0][0][0];
+    for(int i=0; i<2 * 64 * 64; i++) history[i] /= 2;
+}
+
+// Runs job on the calling thread (as thread 0) and on every helper, returning once all are done
+static void run_job(Engine *engine, void (*job)(Engine *engine, int thread_id)){
+    {
+        std::lock_guard<std::mutex> guard(engine->lock);
+        engine->job = job;
+        engine->helpers_running = engine->num_threads - 1;
+        engine->search_id++;
+    }
+    engine->wake.notify_all();
+    job(engine, 0);
+
+    std::unique_lock<std::mutex> guard(engine->lock);
+    while(engine->helpers_running > 0) engine->done.wait(guard);
+}
+
+// Every thread searches the same root, sharing the transposition table
+static void lazy_smp_job(Engine *engine, int thread_id){
+    iterative_deepening(&engine->contexts[thread_id]);
+}
+
+// Sets every context up for a search of root, the time limits are set by the caller
+static void start_search(Engine *engine, Board *root){
+    engine->shared.stop = false;
+    tt_new_search(&engine->tt);
+    for(int i=0; i<engine->num_threads; i++){
+        prepare_context(engine, &engine->contexts[i], i, &engine->shared, root);
+    }
+}
+
+static void ponder_main(Engine *engine){
+    run_job(engine, lazy_smp_job);
+    std::lock_guard<std::mutex> guard(engine->lock);
+    engine->ponder_finished = true;
+    engine->done.notify_all();
+}
+
+// Starts searching, in the background and without a time limit, the position after best_move and the
+// reply the table expects. Nothing is started if there is no such reply or the game would be over
+static void start_ponder(Engine *engine, Move best_move){
+    Board board = engine->position;
+    StateInfo states[2]; // Neither move is taken back, the search starts from the copy
+    apply_move(&board, best_move, &states[0]);
+    TTHit hit;
+    Move moves[MAX_MOVES];
+    if(!tt_probe(&engine->tt, board.hash, &hit) || !move_is_legal(&board, hit.move)) return;
+    apply_move(&board, hit.move, &states[1]);
+    if(generate_moves(&board, moves, GEN_ALL) == 0) return;
+
+    engine->ponder_position = board;
+    time_manager_fixed(&engine->shared.tm, 0, 0);
+    start_search(engine, &board);
+    engine->ponder_finished = false;
+    engine->pondering = true;
+    engine->ponder_thread = std::thread(ponder_main, engine);
+}
+
+// Cancels a running ponder search. What it stored in the transposition table stays useful
+void engine_ponder_stop(Engine *engine){
+    if(!engine->pondering) return;
+    engine->shared.stop = true;
+    engine->ponder_thread.join();
+    engine->pondering = false;
+}
+
+// The expected reply was played: the ponder search goes on as the real one, with this move's soft limit
+// counted from now on top of the time it already had, unless it ends on its own first
+static void ponder_hit(Engine *engine, double per_move_time, double total_time){
+    TimeManager tm;
+    time_manager_init(&tm, total_time, per_move_time, engine->ponder_position.fullmove_number);
+    TimePoint deadline = tm.start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(tm.soft_limit));
+    {
+        std::unique_lock<std::mutex> guard(engine->lock);
+        while(!engine->ponder_finished && engine->done.wait_until(guard, deadline) != std::cv_status::timeout);
+    }
+    engine_ponder_stop(engine);
+}
+
+// Writes the principal variation from the root: best_move, then the table move of each following position
+static void collect_pv(Engine *engine, Move best_move, int max_length, char *out){
+    Board board = engine->position;
+    Move move = best_move;
+    StateInfo state; // Moves are played on a copy and never taken back
+    uint64_t seen[MAX_PLY];
+    char *end = out;
+    *out = '\0';
+    for(int length=0; length<max_length && length<MAX_PLY; length++){
+        if(end != out) *end++ = ' ';
+        move_to_uci(move, end);
+        end += strlen(end);
+        apply_move(&board, move, &state);
+        seen[length] = board.hash;
+
+        TTHit hit;
+        if(!tt_probe(&engine->tt, board.hash, &hit) || !move_is_legal(&board, hit.move)) break;
+        move = hit.move;
+        bool repeated = false;
+        for(int i=0; i<length; i++) repeated |= seen[i] == board.hash;
+        if(repeated) break;
+    }
+}
+
+// Adds up the counters of every thread, the result comes from the thread best came from
+static void collect_stats(Engine *engine, SearchContext *best){
+    SearchStats *stats = &engine->stats;
+    memset(stats, 0, sizeof(SearchStats));
+    for(int i=0; i<engine->num_threads; i++){
+        SearchStats *thread = &engine->contexts[i].stats;
+        stats->nodes += engine->contexts[i].nodes;
+        stats->qnodes += thread->qnodes;
+        stats->tt_probes += thread->tt_probes;
+        stats->tt_hits += thread->tt_hits;
+        stats->cutoffs += thread->cutoffs;
+        stats->first_move_cutoffs += thread->first_move_cutoffs;
+        for(int stage=0; stage<NUM_CUTOFF_STAGES; stage++) stats->stage_cutoffs[stage] += thread->stage_cutoffs[stage];
+        if(thread->seldepth > stats->seldepth) stats->seldepth = thread->seldepth;
+    }
+    stats->depth = best->completed_depth;
+    stats->score = best->best_score;
+    stats->time = seconds_since(engine->shared.tm.start);
+    memcpy(stats->depth_time, engine->contexts[0].stats.depth_time, sizeof(stats->depth_time));
+    collect_pv(engine, best->best_move, best->completed_depth > 0 ? best->completed_depth : 1, stats->pv);
+}
+
+// Picks the move of the thread with the deepest completed iteration and starts pondering if enabled
+static const char *finish_search(Engine *engine){
+    // A helper that completed a deeper iteration than the main thread has the better move
+    SearchContext *best = &engine->contexts[0];
+    for(int i=1; i<engine->num_threads; i++){
+        if(engine->contexts[i].completed_depth > best->completed_depth){
+            best = &engine->contexts[i];
+        }
+    }
+    collect_stats(engine, best);
+    move_to_uci(best->best_move, engine->output);
+    if(engine->ponder) start_ponder(engine, best->best_move);
+    return engine->output;
+}
+
+// Searches root on every thread and returns the move in UCI notation, NULL if there are no legal moves
+// root becomes the position that the moves of the next engine_search are played from
+static const char *search_position(Engine *engine, Board *root, double per_move_time, double total_time){
+    if(engine->pondering){
+        if(root->hash == engine->ponder_position.hash && !memcmp(root->squares, engine->ponder_position.squares, sizeof(root->squares))){
+            ponder_hit(engine, per_move_time, total_time);
+            engine->position = *root;
+            return finish_search(engine);
+        }
+        engine_ponder_stop(engine);
+    }
+
+    engine->position = *root;
+    Move moves[MAX_MOVES];
+    if(generate_moves(root, moves, GEN_ALL) == 0){
+        return NULL; // No Legal Moves
+    }
+
+    // A book move is played at once, without a search (and without pondering, the table has no reply)
+    Move book_move;
+    if(engine->use_book && book_probe(&engine->book, root, engine->book_best, &engine->book_seed, &book_move)){
+        memset(&engine->stats, 0, sizeof(SearchStats));
+        move_to_uci(book_move, engine->output);
+        strcpy(engine->stats.pv, engine->output);
+        return engine->output;
+    }
+
+    time_manager_init(&engine->shared.tm, total_time, per_move_time, root->fullmove_number);
+    start_search(engine, root);
+    run_job(engine, lazy_smp_job);
+    return finish_search(engine);
+}
+
+// Searches a position given as a FEN, a list of UCI moves, or both. The moves are played from the FEN,
+// or when fen is NULL from the position of the previous search (the start position after engine_new_game).
+// per_move_time is the most this move may take and total_time what is left on the game clock, in seconds,
+// 0 for no limit of that kind. Returns the move in UCI notation, valid until the next call, or NULL if there
+// is no legal move or the FEN or a move is invalid (the previous position is then kept)
+const char *engine_search(Engine *engine, const char *fen, const char *moves, double per_move_time, double total_time){
+    Board root = engine->position;
+    if(fen != NULL && !board_from_fen(&root, fen)) return NULL;
+    if(moves != NULL && !apply_uci_moves(&root, moves)) return NULL;
+    return search_position(engine, &root, per_move_time, total_time);
+}
+
+// As engine_search, with the position given as a Board. Only the Python visible prefix is read
+const char *engine_search_board(Engine *engine, Board *board, double per_move_time, double total_time){
+    Board root;
+    memcpy(&root, board, PYTHON_BOARD_SIZE);
+    init_board_state(&root);
+    return search_position(engine, &root, per_move_time, total_time);
+}
+
+// Each thread takes positions from the batch one at a time and searches them alone
+static void batch_job(Engine *engine, int thread_id){
+    SearchContext *ctx = &engine->contexts[thread_id];
+    BatchJob *batch = engine->batch;
+    int i;
+    while((i = batch->next.fetch_add(1)) < batch->count){
+        Board root;
+        batch->moves[i][0] = '\0';
+        if(batch->scores) batch->scores[i] = 0;
+        if(batch->evals) batch->evals[i] = 0;
+        if(batch->boards){
+            memcpy(&root, batch->boards + (size_t)i * PYTHON_BOARD_SIZE, PYTHON_BOARD_SIZE);
+            init_board_state(&root);
+        }
+        else if(!board_from_fen(&root, batch->fens[i])){
+            continue;
+        }
+
+        prepare_context(engine, ctx, 0, &ctx->local, &root);
+        if(batch->evals) batch->evals[i] = evaluate_board(&ctx->board, ctx->pawn_table);
+        Move moves[MAX_MOVES];
+        if(generate_moves(&root, moves, GEN_ALL) == 0) continue;
+
+        double seconds = batch->time_limits ? batch->time_limits[i] : 0;
+        uint64_t nodes = batch->node_limits ? batch->node_limits[i] : 0;
+        ctx->local.stop = false;
+        time_manager_fixed(&ctx->local.tm, seconds, (seconds > 0 || nodes > 0) ? nodes : BATCH_DEFAULT_NODES);
+        iterative_deepening(ctx);
+
+        move_to_uci(ctx->best_move, batch->moves[i]);
+        if(batch->scores) batch->scores[i] = ctx->completed_depth ? ctx->best_score : evaluate_board(&ctx->board, ctx->pawn_table);
+    }
+}
+
+// Searches count positions in parallel, one per engine thread at a time, for self play and data generation.
+// Positions are boards or, when boards is NULL, fens. boards is not a Board[]: it is the packed ctypes layout,
+// the Python visible prefix of each Board (PYTHON_BOARD_SIZE bytes) back to back. Each is searched for
+// time_limits[i] seconds and/or node_limits[i] nodes, either array may be NULL and a 0 entry means no limit
+// of that kind (BATCH_DEFAULT_NODES when a position has neither). Results go to moves[i] (UCI, empty when
+// there is no legal move or the FEN is invalid), scores[i] and evals[i] (static evaluation), both from the
+// side to move's view and optional. Nothing is allocated. Returns the number of positions given a move
+int engine_search_batch(Engine *engine, int count, const void *boards, const char *const *fens,
+                        const double *time_limits, const uint64_t *node_limits, char (*moves)[6], int *scores, int *evals){
+    BatchJob batch;
+    batch.count = count;
+    batch.boards = (const char *)boards;
+    batch.fens = fens;
+    batch.time_limits = time_limits;
+    batch.node_limits = node_limits;
+    batch.moves = moves;
+    batch.scores = scores;
+    batch.evals = evals;
+    batch.next = 0;
+    if(boards == NULL && fens == NULL) return 0;
+
+    engine_ponder_stop(engine);
+    tt_new_search(&engine->tt);
+    engine->batch = &batch;
+    run_job(engine, batch_job);
+    engine->batch = NULL;
+
+    int found = 0;
+    for(int i=0; i<count; i++) found += moves[i][0] != '\0';
+    return found;
+}
+
+// --------------------- //
+
+// ------- Single Engine Interface ---------- //
+// The original calls, kept for existing callers. They all act on one engine created on first use
+
+Engine *default_engine = NULL;
+
+static Engine *get_default_engine(){
+    if(default_engine == NULL) default_engine = engine_create(NULL);
+    return default_engine;
+}
+
+// Sets the transposition table size and builds the bitbases if load_bitbases has not, call once before searching
+void engine_init(int hash_mb){
+    load_bitbases(NULL);
+    engine_ponder_stop(get_default_engine());
+    tt_resize(&get_default_engine()->tt, hash_mb);
+}
+
+// Sets how many threads search in parallel, all sharing the transposition table
+void set_threads(int threads){
+    Engine *engine = get_default_engine();
+    engine_ponder_stop(engine);
+    stop_threads(engine);
+    start_threads(engine, threads);
+}
+
+int set_search_option(const char *name, int value){
+    return engine_set_option(get_default_engine(), name, value);
+}
+
+// Maps a network weight file, see network_load(). An empty path or NULL goes back to the piece square evaluation
+int set_eval_file(const char *path){
+    Engine *engine = get_default_engine();
+    engine_ponder_stop(engine);
+    network_unload(&engine->network);
+    tt_clear(&engine->tt); // Scores from the other evaluation would mislead the next search
+    if(path == NULL || path[0] == '\0') return 1;
+    return network_load(&engine->network, path);
+}
+
+// Maps a Polyglot opening book, see engine_set_book()
+int set_book_file(const char *path){
+    return engine_set_book(get_default_engine(), path);
+}
+
+// Choosing the Best Move within the time constraints
+// per_move_time is the most this move may take and total_time what is left on the game clock, in seconds
+// Only the Python visible prefix of *board_in is read, the bitboards are rebuilt on a local copy
+const char *choose_best_move(Board *board_in, double per_move_time, double total_time){
+    return engine_search_board(get_default_engine(), board_in, per_move_time, total_time);
+}
+
+// Statistics of the last choose_best_move call, see engine_stats_json()
+const char *search_stats_json(){
+    return engine_stats_json(get_default_engine());
+}
@@ -0,0 +1,267 @@
+// Perft: counts the leaf nodes of the legal move tree to check and time generate_moves/apply_move/undo_move
+// Built on its own from the engine source, see README
+//
+// perft [-t threads] [-H hash_mb] suite             every position of PERFT_SUITE and SEE_SUITE, exit code 1 on a mismatch
+// perft [-t threads] [-H hash_mb] <depth> [fen]     node count of one position (start position by default)
+// perft [-t threads] [-H hash_mb] divide <depth> [fen]   node count below each root move
+
+#include "chess_agent.cpp"
+
+typedef struct {
+    const char *fen;
+    int depth;
+    uint64_t nodes;
+} PerftPosition;
+
+// Known counts, the first six are the standard chessprogramming.org positions
+const PerftPosition PERFT_SUITE[] = {
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, 4865609},
+    {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603},
+    {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 6, 11030083},
+    {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 5, 15833292},
+    {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, 2103487},
+    {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594},
+    // Discovered checks through en passant, castling through check, promotions and underpromotions
+    {"8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1", 6, 1440467},
+    {"5k2/8/8/8/8/8/8/4K2R w K - 0 1", 6, 661072},
+    {"3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1", 6, 1134888},
+    {"8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1", 6, 1015133},
+    {"r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1", 4, 1274206},
+    {"r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1", 4, 1720476},
+    {"2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1", 6, 3821001},
+    {"8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1", 5, 1004658},
+    {"4k3/1P6/8/8/8/8/K7/8 w - - 0 1", 6, 217342},
+    {"8/P1k5/K7/8/8/8/8/8 w - - 0 1", 6, 92683},
+    {"K1k5/8/P7/8/8/8/8/8 w - - 0 1", 6, 2217},
+    {"8/k1P5/8/1K6/8/8/8/8 w - - 0 1", 7, 567584},
+    {"8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1", 4, 23527},
+};
+
+typedef struct {
+    const char *fen;
+    const char *move; // UCI
+    int value; // see() with PEICE_VALUES
+} SeePosition;
+
+// Exchange balances checked with the suite, the first two are the chessprogramming.org SEE examples
+const SeePosition SEE_SUITE[] = {
+    {"1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1", "e1e5", 100},
+    {"1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - - 0 1", "d3e5", -220},
+    {"4k3/8/8/3p4/4P3/8/8/4K3 w - - 0 1", "e4d5", 100},
+    {"4k3/8/1n6/3p4/4P3/8/8/4K3 w - - 0 1", "e4d5", 0},
+    {"4k3/8/1n6/3p4/8/2N5/8/4K3 w - - 0 1", "c3d5", -220},
+};
+
+// Subtree counts shared by all threads, checked the same way as the transposition table:
+// an entry torn by a concurrent write no longer matches its key and reads as a miss
+typedef struct {
+    std::atomic<uint64_t> key_xor_nodes;
+    std::atomic<uint64_t> nodes;
+} PerftEntry;
+
+typedef struct {
+    PerftEntry *entries;
+    uint64_t num_entries;
+} PerftHash;
+
+PerftHash perft_hash = {NULL, 0};
+
+// The depth is folded into the key so one position is stored once per remaining depth
+static inline uint64_t perft_key(Board *board, int depth){
+    return board->hash ^ ((uint64_t)depth << 56);
+}
+
+static inline PerftEntry *perft_entry(uint64_t key){
+    return &perft_hash.entries[(uint64_t)(((unsigned __int128)key * perft_hash.num_entries) >> 64)];
+}
+
+// Leaf nodes depth plies below board. The last ply is bulk counted: the legal move count is the leaf count
+uint64_t perft(Board *board, int depth){
+    Move moves[MAX_MOVES];
+    int num_moves = generate_moves(board, moves, GEN_ALL);
+    if(depth <= 1) return depth == 1 ? num_moves : 1;
+
+    uint64_t key = 0;
+    if(perft_hash.entries){
+        key = perft_key(board, depth);
+        PerftEntry *entry = perft_entry(key);
+        uint64_t nodes = entry->nodes.load(std::memory_order_relaxed);
+        if((entry->key_xor_nodes.load(std::memory_order_relaxed) ^ nodes) == key) return nodes;
+    }
+
+    uint64_t nodes = 0;
+    StateInfo state;
+    for(int i=0; i<num_moves; i++){
+        apply_move(board, moves[i], &state);
+        nodes += perft(board, depth - 1);
+        undo_move(board, moves[i], &state);
+    }
+
+    if(perft_hash.entries){
+        PerftEntry *entry = perft_entry(key);
+        entry->key_xor_nodes.store(key ^ nodes, std::memory_order_relaxed);
+        entry->nodes.store(nodes, std::memory_order_relaxed);
+    }
+    return nodes;
+}
+
+// Root moves are shared out between the threads, each with its own copy of the board
+typedef struct {
+    Board root;
+    Move moves[MAX_MOVES];
+    uint64_t counts[MAX_MOVES]; // Nodes below each root move
+    int num_moves;
+    int depth;
+    std::atomic<int> next;
+} PerftRoot;
+
+static void perft_worker(PerftRoot *job){
+    Board board = job->root;
+    StateInfo state;
+    int i;
+    while((i = job->next.fetch_add(1)) < job->num_moves){
+        apply_move(&board, job->moves[i], &state);
+        job->counts[i] = perft(&board, job->depth - 1);
+        undo_move(&board, job->moves[i], &state);
+    }
+}
+
+// Fills job->counts for every root move of board, on threads threads
+static void perft_root(PerftRoot *job, Board *board, int depth, int threads){
+    job->root = *board;
+    job->depth = depth;
+    job->num_moves = generate_moves(board, job->moves, GEN_ALL);
+    job->next = 0;
+
+    std::thread *helpers = new std::thread[threads - 1];
+    for(int i=0; i<threads - 1; i++){
+        helpers[i] = std::thread(perft_worker, job);
+    }
+    perft_worker(job);
+    for(int i=0; i<threads - 1; i++){
+        helpers[i].join();
+    }
+    delete[] helpers;
+}
+
+static uint64_t perft_total(Board *board, int depth, int threads){
+    if(depth < 1) return 1;
+    PerftRoot job;
+    perft_root(&job, board, depth, threads);
+    uint64_t nodes = 0;
+    for(int i=0; i<job.num_moves; i++) nodes += job.counts[i];
+    return nodes;
+}
+
+static void perft_clear_hash(){
+    if(perft_hash.entries) memset((void *)perft_hash.entries, 0, perft_hash.num_entries * sizeof(PerftEntry));
+}
+
+static void print_speed(uint64_t nodes, double seconds){
+    printf("Nodes: %llu  Time: %.3f s  Speed: %.2f MNPS\n", (unsigned long long)nodes, seconds, seconds > 0 ? nodes / seconds / 1e6 : 0.0);
+}
+
+// Number of SEE_SUITE positions whose move is missing or valued differently
+static int run_see_suite(){
+    int failures = 0;
+    for(size_t i=0; i<sizeof(SEE_SUITE) / sizeof(SEE_SUITE[0]); i++){
+        const SeePosition *position = &SEE_SUITE[i];
+        Board board;
+        board_from_fen(&board, position->fen);
+        Move moves[MAX_MOVES];
+        int num_moves = generate_moves(&board, moves, GEN_ALL);
+        int value = INFINITY;
+        for(int j=0; j<num_moves; j++){
+            char uci[6];
+            move_to_uci(moves[j], uci);
+            if(!strcmp(uci, position->move)) value = see(&board, moves[j]);
+        }
+        bool ok = value == position->value;
+        failures += !ok;
+        printf("%-4s see %-5s %5d  %s\n", ok ? "ok" : "FAIL", position->move, value, position->fen);
+        if(!ok) printf("     expected %d\n", position->value);
+    }
+    return failures;
+}
+
+static int run_suite(int threads){
+    int failures = run_see_suite();
+    uint64_t total_nodes = 0;
+    TimePoint start = std::chrono::steady_clock::now();
+    for(size_t i=0; i<sizeof(PERFT_SUITE) / sizeof(PERFT_SUITE[0]); i++){
+        const PerftPosition *position = &PERFT_SUITE[i];
+        Board board;
+        board_from_fen(&board, position->fen);
+        perft_clear_hash(); // Each position on its own, so the timing does not depend on the order
+        TimePoint position_start = std::chrono::steady_clock::now();
+        uint64_t nodes = perft_total(&board, position->depth, threads);
+        double seconds = seconds_since(position_start);
+        bool ok = nodes == position->nodes;
+        failures += !ok;
+        total_nodes += nodes;
+        printf("%-4s depth %d %12llu %8.2f MNPS  %s\n", ok ? "ok" : "FAIL", position->depth, (unsigned long long)nodes,
+               seconds > 0 ? nodes / seconds / 1e6 : 0.0, position->fen);
+        if(!ok) printf("     expected %llu\n", (unsigned long long)position->nodes);
+    }
+    print_speed(total_nodes, seconds_since(start));
+    printf("%d of %d positions failed\n", failures, (int)(sizeof(PERFT_SUITE) / sizeof(PERFT_SUITE[0]) + sizeof(SEE_SUITE) / sizeof(SEE_SUITE[0])));
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char **argv){
+    int threads = 1;
+    int hash_mb = 0;
+    int arg = 1;
+    while(arg + 1 < argc && argv[arg][0] == '-'){
+        if(!strcmp(argv[arg], "-t")) threads = atoi(argv[arg + 1]);
+        else if(!strcmp(argv[arg], "-H")) hash_mb = atoi(argv[arg + 1]);
+        else break;
+        arg += 2;
+    }
+    if(threads < 1) threads = 1;
+    if(hash_mb > 0){
+        perft_hash.num_entries = ((uint64_t)hash_mb << 20) / sizeof(PerftEntry);
+        perft_hash.entries = (PerftEntry *)calloc(perft_hash.num_entries, sizeof(PerftEntry));
+    }
+
+    if(arg >= argc){
+        printf("usage: perft [-t threads] [-H hash_mb] suite | <depth> [fen] | divide <depth> [fen]\n");
+        return 2;
+    }
+    if(!strcmp(argv[arg], "suite")){
+        return run_suite(threads);
+    }
+
+    bool divide = !strcmp(argv[arg], "divide");
+    if(divide) arg++;
+    if(arg >= argc){
+        printf("missing depth\n");
+        return 2;
+    }
+    int depth = atoi(argv[arg++]);
+    Board board;
+    if(!board_from_fen(&board, arg < argc ? argv[arg] : START_FEN)){
+        printf("invalid fen\n");
+        return 2;
+    }
+
+    TimePoint start = std::chrono::steady_clock::now();
+    uint64_t nodes;
+    if(divide && depth >= 1){
+        PerftRoot job;
+        perft_root(&job, &board, depth, threads);
+        nodes = 0;
+        for(int i=0; i<job.num_moves; i++){
+            char uci[6];
+            move_to_uci(job.moves[i], uci);
+            printf("%s: %llu\n", uci, (unsigned long long)job.counts[i]);
+            nodes += job.counts[i];
+        }
+        printf("Moves: %d\n", job.num_moves);
+    }
+    else{
+        nodes = perft_total(&board, depth, threads);
+    }
+    print_speed(nodes, seconds_since(start));
+    return 0;
+}